@@ -20,6 +20,11 @@ public:
     constexpr static const auto PrivateWindowAction = "privateWindowActions";
     // UI settings
     constexpr static const auto GeneralMinimized = "generalMinimized";
+    // Cache settings, seconds after closing KRunner until the caches are released. 0 keeps them
+    constexpr static const auto IdleEvictionSeconds = "idleEvictionSeconds";
+    constexpr static const int IdleEvictionSecondsDefault = 300;
+    // Search with zen-bookmark-daemon if it runs, the own index is only loaded if it does not answer
+    constexpr static const auto UseIndexDaemon = "useIndexDaemon";
 
     static QString getPrivateWindowIcon()
     {
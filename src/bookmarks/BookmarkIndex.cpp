@@ -0,0 +1,235 @@
+#include "BookmarkIndex.h"
+
+#include <QRegularExpression>
+#include <QUrl>
+
+#include <algorithm>
+
+const Bookmark *BookmarkIndex::find(qint64 id) const
+{
+    const auto it = m_positions.constFind(id);
+    return it == m_positions.constEnd() ? nullptr : &m_bookmarks.at(it.value());
+}
+
+QVector<const Bookmark *> BookmarkIndex::bookmarksInFolder(const QString &folder) const
+{
+    QVector<const Bookmark *> bookmarks;
+    for (const qint64 id : m_folderIds.value(folder.toLower())) {
+        bookmarks.append(find(id));
+    }
+    // Folders with the same title are not interleaved
+    std::sort(bookmarks.begin(), bookmarks.end(), [](const Bookmark *a, const Bookmark *b) {
+        return a->folderId != b->folderId ? a->folderId < b->folderId : a->position != b->position ? a->position < b->position : a->id < b->id;
+    });
+    return bookmarks;
+}
+
+void BookmarkIndex::clear()
+{
+    m_bookmarks.clear();
+    m_positions.clear();
+    m_guids.clear();
+    m_keywords.clear();
+    m_tokenIds.clear();
+    m_postings.clear();
+    m_tagIds.clear();
+    m_folderIds.clear();
+    m_wordStarts.clear();
+    modifiedWatermark = 0;
+    visitWatermark = 0;
+    removedWatermark = 0;
+}
+
+void BookmarkIndex::reserve(int size)
+{
+    m_bookmarks.reserve(size);
+    m_positions.reserve(size);
+    m_guids.reserve(size);
+}
+
+/**
+ * Words used by the typo tolerant search, computed once when the bookmark is indexed
+ */
+QStringList BookmarkIndex::normalizedWords(const QString &title, const QString &url)
+{
+    static const QRegularExpression separator(QStringLiteral("[^\\p{L}\\p{N}]+"));
+    QStringList words = title.toLower().split(separator, Qt::SkipEmptyParts);
+    const QStringList labels = QUrl(url).host().toLower().split(QLatin1Char('.'), Qt::SkipEmptyParts);
+    for (const QString &label : labels) {
+        if (label != QLatin1String("www") && !words.contains(label)) {
+            words.append(label);
+        }
+    }
+    return words;
+}
+
+/**
+ * Insert the bookmark or replace the entry with the same id, the watermarks are advanced accordingly
+ */
+void BookmarkIndex::upsert(Bookmark bookmark)
+{
+    const QVector<UrlTerm> urlTerms = prepare(bookmark);
+    upsert(std::move(bookmark), urlTerms);
+}
+
+/**
+ * Everything that only depends on the bookmark itself, this is most of the work of upsert()
+ */
+QVector<UrlTerm> BookmarkIndex::prepare(Bookmark &bookmark)
+{
+    bookmark.displayText = bookmark.title + QLatin1String(" - ") + bookmark.url;
+    bookmark.foldedTitle = bookmark.title.toCaseFolded();
+    bookmark.words = normalizedWords(bookmark.title, bookmark.url);
+    bookmark.host = QUrl(bookmark.url).host().toLower();
+    if (bookmark.host.startsWith(QLatin1String("www."))) {
+        bookmark.host.remove(0, 4);
+    }
+    return UrlTokenizer::tokenize(bookmark.url);
+}
+
+void BookmarkIndex::upsert(Bookmark bookmark, const QVector<UrlTerm> &urlTerms)
+{
+    m_wordStarts.clear();
+    bookmark.urlTokens.clear();
+    for (const UrlTerm &term : urlTerms) {
+        auto tokenIt = m_tokenIds.constFind(term.text);
+        if (tokenIt == m_tokenIds.constEnd()) {
+            tokenIt = m_tokenIds.insert(term.text, m_postings.size());
+            m_postings.append(QVector<UrlPosting>());
+        }
+        bookmark.urlTokens.append(UrlToken{tokenIt.value(), term.field});
+    }
+
+    const qint64 id = bookmark.id;
+    const auto it = m_positions.constFind(id);
+    if (it == m_positions.constEnd()) {
+        m_positions.insert(id, m_bookmarks.size());
+        m_bookmarks.append(std::move(bookmark));
+    } else {
+        Bookmark &existing = m_bookmarks[it.value()];
+        if (existing.guid != bookmark.guid) {
+            m_guids.remove(existing.guid);
+        }
+        removePostings(existing);
+        existing = std::move(bookmark);
+    }
+    const Bookmark &stored = m_bookmarks.at(m_positions.value(id));
+    addPostings(stored);
+    if (!stored.guid.isEmpty()) {
+        m_guids.insert(stored.guid, stored.id);
+    }
+    modifiedWatermark = std::max(modifiedWatermark, stored.lastModified);
+    visitWatermark = std::max(visitWatermark, stored.lastVisitDate);
+}
+
+/**
+ * Remove the bookmark by moving the last entry into its slot, this keeps removal O(1)
+ */
+bool BookmarkIndex::remove(qint64 id)
+{
+    const auto it = m_positions.find(id);
+    if (it == m_positions.end()) {
+        return false;
+    }
+    const int pos = it.value();
+    m_positions.erase(it);
+    m_wordStarts.clear();
+    m_guids.remove(m_bookmarks.at(pos).guid);
+    removePostings(m_bookmarks.at(pos));
+    const int last = m_bookmarks.size() - 1;
+    if (pos != last) {
+        m_bookmarks[pos] = std::move(m_bookmarks[last]);
+        m_positions[m_bookmarks.at(pos).id] = pos;
+    }
+    m_bookmarks.removeLast();
+    return true;
+}
+
+void BookmarkIndex::addPostings(const Bookmark &bookmark)
+{
+    for (const UrlToken &token : bookmark.urlTokens) {
+        m_postings[token.id].append(UrlPosting{bookmark.id, token.field});
+    }
+    for (const QString &tag : bookmark.tags) {
+        m_tagIds[tag.toLower()].insert(bookmark.id);
+    }
+    if (!bookmark.folder.isEmpty()) {
+        m_folderIds[bookmark.folder.toLower()].insert(bookmark.id);
+    }
+}
+
+void BookmarkIndex::removePostings(const Bookmark &bookmark)
+{
+    for (const UrlToken &token : bookmark.urlTokens) {
+        QVector<UrlPosting> &postings = m_postings[token.id];
+        postings.erase(std::remove_if(postings.begin(),
+                                      postings.end(),
+                                      [&bookmark](const UrlPosting &posting) {
+                                          return posting.bookmarkId == bookmark.id;
+                                      }),
+                       postings.end());
+    }
+    const auto removeId = [&bookmark](QHash<QString, QSet<qint64>> &ids, const QString &key) {
+        const auto it = ids.find(key.toLower());
+        if (it != ids.end() && it->remove(bookmark.id) && it->isEmpty()) {
+            ids.erase(it);
+        }
+    };
+    for (const QString &tag : bookmark.tags) {
+        removeId(m_tagIds, tag);
+    }
+    if (!bookmark.folder.isEmpty()) {
+        removeId(m_folderIds, bookmark.folder);
+    }
+}
+
+static qint64 stringBytes(const QString &string)
+{
+    return string.isEmpty() ? 0 : qint64(string.capacity() + 1) * sizeof(QChar);
+}
+
+template<typename Hash>
+static qint64 hashBytes(const Hash &hash)
+{
+    // Node plus bucket pointer, the exact layout differs between Qt 5 and 6
+    return qint64(hash.size()) * (sizeof(typename Hash::key_type) + sizeof(typename Hash::mapped_type) + 2 * sizeof(void *));
+}
+
+IndexMemoryUsage BookmarkIndex::memoryUsage() const
+{
+    IndexMemoryUsage usage;
+    usage.strings = qint64(m_bookmarks.capacity()) * sizeof(Bookmark);
+    for (const Bookmark &bookmark : m_bookmarks) {
+        for (const QString *string : {&bookmark.guid, &bookmark.title, &bookmark.url, &bookmark.folder, &bookmark.displayText, &bookmark.foldedTitle, &bookmark.host}) {
+            usage.strings += stringBytes(*string);
+        }
+        for (const QStringList *list : {&bookmark.tags, &bookmark.words}) {
+            usage.strings += qint64(list->size()) * sizeof(QString);
+            for (const QString &string : *list) {
+                usage.strings += stringBytes(string);
+            }
+        }
+        usage.urlTokens += qint64(bookmark.urlTokens.capacity()) * sizeof(UrlToken);
+    }
+
+    for (auto it = m_tokenIds.cbegin(); it != m_tokenIds.cend(); ++it) {
+        // Map node with three pointers and the color
+        usage.urlTokens += stringBytes(it.key()) + sizeof(QString) + sizeof(quint32) + 4 * sizeof(void *);
+    }
+    usage.urlTokens += qint64(m_postings.capacity()) * sizeof(QVector<UrlPosting>);
+    for (const QVector<UrlPosting> &postings : m_postings) {
+        usage.urlTokens += qint64(postings.capacity()) * sizeof(UrlPosting);
+    }
+
+    usage.lookups = hashBytes(m_positions) + hashBytes(m_guids) + hashBytes(m_keywords) + hashBytes(m_tagIds) + hashBytes(m_folderIds);
+    for (const auto *ids : {&m_tagIds, &m_folderIds}) {
+        for (const QSet<qint64> &set : *ids) {
+            usage.lookups += qint64(set.size()) * (sizeof(qint64) + 2 * sizeof(void *));
+        }
+    }
+    for (const BookmarkKeyword &keyword : m_keywords) {
+        usage.lookups += stringBytes(keyword.keyword) + stringBytes(keyword.title) + stringBytes(keyword.url);
+    }
+    usage.wordStarts = m_wordStarts.memoryUsage();
+    return usage;
+}
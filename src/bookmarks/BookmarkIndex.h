@@ -0,0 +1,219 @@
+#pragma once
+
+#include "UrlTokenizer.h"
+#include "WordStartIndex.h"
+
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+struct UrlToken {
+    quint32 id;
+    UrlField field;
+};
+
+struct Bookmark {
+    qint64 id = 0; // moz_bookmarks.id
+    qint64 placeId = 0; // moz_places.id
+    QString guid;
+    QString title;
+    QString url;
+    qint64 lastModified = 0; // PRTime, microseconds since epoch
+    qint64 lastVisitDate = 0;
+    int frecency = 0;
+    QString folder; // Title of the parent folder
+    qint64 folderId = 0; // moz_bookmarks.id of the parent folder
+    int position = 0; // Within the parent folder
+    QStringList tags;
+    // "title - url" as shown in KRunner, built once by BookmarkIndex so that matches share it
+    QString displayText;
+    // Case folded title for the substring scan, filled in by BookmarkIndex
+    QString foldedTitle;
+    // Lowercase host without "www.", filled in by BookmarkIndex
+    QString host;
+    // Lowercase words of the title and labels of the host, filled in by BookmarkIndex
+    QStringList words;
+    // Token ids of the URL parts, filled in by BookmarkIndex
+    QVector<UrlToken> urlTokens;
+};
+
+/**
+ * Keyword shortcut from moz_keywords, %s in the URL is replaced with the rest of the query
+ */
+struct BookmarkKeyword {
+    QString keyword;
+    QString title;
+    QString url;
+
+    bool operator==(const BookmarkKeyword &other) const
+    {
+        return keyword == other.keyword && title == other.title && url == other.url;
+    }
+};
+
+struct UrlPosting {
+    qint64 bookmarkId;
+    UrlField field;
+};
+
+/**
+ * Estimated heap usage of a BookmarkIndex, allocator overhead is not included
+ */
+struct IndexMemoryUsage {
+    qint64 strings = 0; // Text of the bookmarks and the strings derived from it
+    qint64 urlTokens = 0; // Token map and postings of the URL search
+    qint64 lookups = 0; // Id, guid, tag, folder and keyword hashes
+    qint64 wordStarts = 0; // Candidate lists of short queries
+};
+
+/**
+ * In-memory copy of the bookmarks from places.sqlite. The entries are patched in place by PlacesReader
+ * when the database changes, the watermarks record up to which point changes have been applied.
+ */
+class BookmarkIndex
+{
+public:
+    const QVector<Bookmark> &bookmarks() const
+    {
+        return m_bookmarks;
+    }
+    int size() const
+    {
+        return m_bookmarks.size();
+    }
+    bool isEmpty() const
+    {
+        return m_bookmarks.isEmpty();
+    }
+
+    const Bookmark *find(qint64 id) const;
+    bool contains(qint64 id) const
+    {
+        return m_positions.contains(id);
+    }
+    qint64 idForGuid(const QString &guid) const
+    {
+        return m_guids.value(guid, 0);
+    }
+
+    void clear();
+    void reserve(int size);
+    void upsert(Bookmark bookmark);
+    bool remove(qint64 id);
+
+    /**
+     * Fill in the derived fields of the bookmark and tokenize its URL. This does not touch the index, so that
+     * a full load can prepare the bookmarks on several threads and only insert them with upsert() serially.
+     */
+    static QVector<UrlTerm> prepare(Bookmark &bookmark);
+    void upsert(Bookmark bookmark, const QVector<UrlTerm> &urlTerms);
+
+    /**
+     * Keyword shortcut for the lowercase keyword, nullptr if there is none
+     */
+    const BookmarkKeyword *keyword(const QString &keyword) const
+    {
+        const auto it = m_keywords.constFind(keyword);
+        return it == m_keywords.constEnd() ? nullptr : &it.value();
+    }
+    const QHash<QString, BookmarkKeyword> &keywords() const
+    {
+        return m_keywords;
+    }
+    void setKeywords(const QHash<QString, BookmarkKeyword> &keywords)
+    {
+        m_keywords = keywords;
+    }
+
+    /**
+     * Ids of the bookmarks with the tag or in a folder with the title, both compared case-insensitively
+     */
+    QSet<qint64> idsWithTag(const QString &tag) const
+    {
+        return m_tagIds.value(tag.toLower());
+    }
+    QSet<qint64> idsInFolder(const QString &folder) const
+    {
+        return m_folderIds.value(folder.toLower());
+    }
+    /**
+     * Bookmarks directly in folders with the title in the order of the folder, compared case-insensitively
+     */
+    QVector<const Bookmark *> bookmarksInFolder(const QString &folder) const;
+    /**
+     * Lowercase titles of the folders that contain bookmarks
+     */
+    QStringList folderKeys() const
+    {
+        return m_folderIds.keys();
+    }
+
+    /**
+     * Precomputed candidates of short queries. Changing the bookmarks clears them until buildWordStarts()
+     * is called again, the search falls back to the scan meanwhile.
+     */
+    const WordStartIndex &wordStarts() const
+    {
+        return m_wordStarts;
+    }
+    void buildWordStarts()
+    {
+        m_wordStarts.build(m_bookmarks);
+    }
+
+    static QStringList normalizedWords(const QString &title, const QString &url);
+
+    /**
+     * Call the function with every posting of the URL tokens that start with the prefix
+     */
+    template<typename Function>
+    void forEachUrlPosting(const QString &prefix, Function function) const
+    {
+        for (auto it = m_tokenIds.lowerBound(prefix); it != m_tokenIds.cend() && it.key().startsWith(prefix); ++it) {
+            for (const UrlPosting &posting : m_postings.at(it.value())) {
+                function(posting);
+            }
+        }
+    }
+    /**
+     * Postings of exactly this URL token, nullptr if no URL contains it
+     */
+    const QVector<UrlPosting> *urlPostings(const QString &token) const
+    {
+        const auto it = m_tokenIds.constFind(token);
+        return it == m_tokenIds.constEnd() ? nullptr : &m_postings.at(it.value());
+    }
+    IndexMemoryUsage memoryUsage() const;
+    int tokenCount() const
+    {
+        return m_tokenIds.size();
+    }
+
+    // Incremented for every published snapshot
+    quint64 generation = 0;
+
+    // Highest moz_bookmarks.lastModified and moz_places.last_visit_date values that are applied
+    qint64 modifiedWatermark = 0;
+    qint64 visitWatermark = 0;
+    // Highest moz_bookmarks_deleted.dateRemoved value that is applied
+    qint64 removedWatermark = 0;
+
+private:
+    void addPostings(const Bookmark &bookmark);
+    void removePostings(const Bookmark &bookmark);
+
+    QVector<Bookmark> m_bookmarks;
+    QHash<qint64, int> m_positions;
+    QHash<QString, qint64> m_guids;
+    QHash<QString, BookmarkKeyword> m_keywords;
+    // Sorted, so that tokens with a common prefix are adjacent. Ids are never reused.
+    QMap<QString, quint32> m_tokenIds;
+    QVector<QVector<UrlPosting>> m_postings;
+    // Keyed by the lowercase tag and folder title
+    QHash<QString, QSet<qint64>> m_tagIds;
+    QHash<QString, QSet<qint64>> m_folderIds;
+    WordStartIndex m_wordStarts;
+};
@@ -0,0 +1,194 @@
+#include "BookmarkQuery.h"
+
+#include <QUrl>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+BookmarkQuery BookmarkQuery::parse(const QString &filter)
+{
+    BookmarkQuery query;
+    const int size = filter.size();
+    int i = 0;
+    while (i < size) {
+        if (filter.at(i).isSpace()) {
+            ++i;
+            continue;
+        }
+        const bool negated = filter.at(i) == QLatin1Char('-') && i + 1 < size && !filter.at(i + 1).isSpace();
+        if (negated) {
+            ++i;
+        }
+
+        // An operator is a known name followed by a colon, anything else like "http://" is a term
+        QStringList *target = negated ? &query.excluded : &query.terms;
+        int nameEnd = i;
+        while (nameEnd < size && filter.at(nameEnd).isLetter()) {
+            ++nameEnd;
+        }
+        if (!negated && nameEnd < size && filter.at(nameEnd) == QLatin1Char(':')) {
+            const QString name = filter.mid(i, nameEnd - i).toLower();
+            if (name == QLatin1String("site")) {
+                target = &query.sites;
+            } else if (name == QLatin1String("folder")) {
+                target = &query.folders;
+            } else if (name == QLatin1String("tag")) {
+                target = &query.tags;
+            }
+            if (target != &query.terms) {
+                i = nameEnd + 1;
+            }
+        }
+
+        // The value is quoted or ends at the next whitespace, an unterminated quote extends to the end
+        QString value;
+        if (i < size && filter.at(i) == QLatin1Char('"')) {
+            const int close = filter.indexOf(QLatin1Char('"'), i + 1);
+            const int end = close == -1 ? size : close;
+            value = filter.mid(i + 1, end - i - 1).simplified();
+            i = end + 1;
+        } else {
+            int end = i;
+            while (end < size && !filter.at(end).isSpace()) {
+                ++end;
+            }
+            value = filter.mid(i, end - i);
+            i = end;
+        }
+        if (value.isEmpty()) {
+            continue;
+        }
+
+        if (target == &query.sites) {
+            if (value.contains(QLatin1String("://"))) {
+                value = QUrl(value).host();
+            }
+            value = value.toLower();
+            if (value.startsWith(QLatin1String("www."))) {
+                value.remove(0, 4);
+            }
+            while (value.endsWith(QLatin1Char('/'))) {
+                value.chop(1);
+            }
+            if (value.isEmpty()) {
+                continue;
+            }
+        }
+        target->append(value);
+    }
+    return query;
+}
+
+void BookmarkQuery::filter(const BookmarkIndex &index, std::pmr::vector<const Bookmark *> &candidates) const
+{
+    std::pmr::memory_resource *resource = candidates.get_allocator().resource();
+    std::pmr::vector<QSet<qint64>> idSets(resource);
+    for (const QString &tag : tags) {
+        idSets.push_back(index.idsWithTag(tag));
+    }
+    for (const QString &folder : folders) {
+        idSets.push_back(index.idsInFolder(folder));
+    }
+    for (const QString &site : sites) {
+        idSets.push_back(siteIds(index, site));
+    }
+    std::sort(idSets.begin(), idSets.end(), [](const QSet<qint64> &a, const QSet<qint64> &b) {
+        return a.size() < b.size();
+    });
+
+    struct Predicate {
+        int cost;
+        std::function<bool(const Bookmark &)> test;
+    };
+    std::pmr::vector<Predicate> predicates(resource);
+    for (std::size_t i = 1; i < idSets.size(); ++i) {
+        predicates.push_back({0, [&ids = idSets[i]](const Bookmark &bookmark) {
+                                  return ids.contains(bookmark.id);
+                              }});
+    }
+    // The postings of a site token also contain other hosts and paths with the word
+    for (const QString &site : sites) {
+        predicates.push_back({1, [&site](const Bookmark &bookmark) {
+                                  return matchesSite(bookmark.host, site);
+                              }});
+    }
+    for (const QString &word : excluded) {
+        predicates.push_back({2, [&word](const Bookmark &bookmark) {
+                                  return !bookmark.title.contains(word, Qt::CaseInsensitive) && !bookmark.url.contains(word, Qt::CaseInsensitive);
+                              }});
+    }
+    std::stable_sort(predicates.begin(), predicates.end(), [](const Predicate &a, const Predicate &b) {
+        return a.cost < b.cost;
+    });
+    const auto accepts = [&predicates](const Bookmark &bookmark) {
+        return std::all_of(predicates.cbegin(), predicates.cend(), [&bookmark](const Predicate &predicate) {
+            return predicate.test(bookmark);
+        });
+    };
+
+    candidates.clear();
+    if (idSets.empty()) {
+        candidates.reserve(index.size());
+        for (const Bookmark &bookmark : index.bookmarks()) {
+            if (accepts(bookmark)) {
+                candidates.push_back(&bookmark);
+            }
+        }
+        return;
+    }
+    candidates.reserve(idSets.front().size());
+    for (const qint64 id : idSets.front()) {
+        const Bookmark *bookmark = index.find(id);
+        if (bookmark && accepts(*bookmark)) {
+            candidates.push_back(bookmark);
+        }
+    }
+}
+
+QSet<qint64> BookmarkQuery::siteIds(const BookmarkIndex &index, const QString &site)
+{
+    QSet<qint64> ids;
+    const QStringList words = UrlTokenizer::words(site);
+    if (words.isEmpty()) {
+        return ids;
+    }
+    // The longest word has the fewest postings in practice
+    const QString &word = *std::max_element(words.cbegin(), words.cend(), [](const QString &a, const QString &b) {
+        return a.size() < b.size();
+    });
+    if (const QVector<UrlPosting> *postings = index.urlPostings(word)) {
+        ids.reserve(postings->size());
+        for (const UrlPosting &posting : *postings) {
+            ids.insert(posting.bookmarkId);
+        }
+    }
+    return ids;
+}
+
+/**
+ * The host or one of its parent domains is the site. A site without a dot like "github" matches
+ * any label of the host.
+ */
+bool BookmarkQuery::matchesSite(const QString &host, const QString &site)
+{
+    const int hostSize = host.size();
+    const int siteSize = site.size();
+    if (host.endsWith(site) && (hostSize == siteSize || host.at(hostSize - siteSize - 1) == QLatin1Char('.'))) {
+        return true;
+    }
+    if (site.contains(QLatin1Char('.'))) {
+        return false;
+    }
+    for (int start = 0; start < hostSize;) {
+        int end = host.indexOf(QLatin1Char('.'), start);
+        if (end == -1) {
+            end = hostSize;
+        }
+        if (end - start == siteSize && QStringView(host).mid(start, siteSize) == QStringView(site)) {
+            return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "BookmarkIndex.h"
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <memory_resource>
+#include <vector>
+
+/**
+ * Parsed bookmark query. Besides plain terms it supports the operators site:github.com, folder:Work, tag:runbook,
+ * -exclude and "quoted phrases", values of operators can be quoted too, e.g. folder:"Side projects".
+ * All terms and operators have to match.
+ */
+class BookmarkQuery
+{
+public:
+    static BookmarkQuery parse(const QString &filter);
+
+    // Words and phrases that have to be found in the title or URL, they are scored by BookmarkSearch
+    QStringList terms;
+    // Bookmarks with one of these in the title or URL are dropped
+    QStringList excluded;
+    QStringList sites; // Lowercase host, matches subdomains as well
+    QStringList folders;
+    QStringList tags;
+
+    /**
+     * The terms joined by spaces, used to rank titles containing the whole query and by the typo tolerant search
+     */
+    QString text() const
+    {
+        return terms.join(QLatin1Char(' '));
+    }
+
+    /**
+     * Bookmarks that pass all operators. The id sets of tag:, folder: and site: are intersected first, starting
+     * with the smallest one, after that the predicates run on the remaining bookmarks ordered by their cost.
+     * Without operators this returns every bookmark of the index. The scratch buffers come from the memory
+     * resource of candidates, see QueryArena.
+     */
+    void filter(const BookmarkIndex &index, std::pmr::vector<const Bookmark *> &candidates) const;
+
+    /**
+     * Superset of the bookmarks on the site, from the postings of one of its URL tokens
+     */
+    static QSet<qint64> siteIds(const BookmarkIndex &index, const QString &site);
+    static bool matchesSite(const QString &host, const QString &site);
+};
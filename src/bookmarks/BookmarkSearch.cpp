@@ -0,0 +1,462 @@
+#include "BookmarkSearch.h"
+
+#include "EditDistance.h"
+#include "ParallelFor.h"
+#include "QueryArena.h"
+#include "SubstringSearch.h"
+
+#include <QUrl>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+static std::atomic<int> s_parallelThreshold{BookmarkSearch::DefaultParallelThreshold};
+
+QStringList FolderResult::urls() const
+{
+    QStringList urls;
+    urls.reserve(bookmarks.size());
+    for (const Bookmark *bookmark : bookmarks) {
+        urls.append(bookmark->url);
+    }
+    return urls;
+}
+
+QString FolderResult::text() const
+{
+    return QStringLiteral("%1 - open all %2 bookmarks").arg(title).arg(bookmarks.size());
+}
+
+/**
+ * Score the candidates and append the best limit of them to results, 0 keeps all. Large candidate lists are split
+ * into chunks that are scored in parallel, each keeping its own top limit, the caller sorts the merged results.
+ * Returns the number of candidates with a relevance above 0, which may be more than were kept.
+ */
+template<typename Score>
+static std::size_t rank(const BookmarkSearch::Candidates &candidates, const Score &score, int limit, BookmarkSearch::Results &results)
+{
+    using Results = BookmarkSearch::Results;
+    const std::size_t keep = limit > 0 ? std::size_t(limit) : std::numeric_limits<std::size_t>::max();
+    // Once full, kept is a heap with the worst result at the front
+    const auto add = [keep](Results &kept, const SearchResult &result) {
+        if (kept.size() < keep) {
+            kept.push_back(result);
+            if (kept.size() == keep) {
+                std::make_heap(kept.begin(), kept.end(), BookmarkSearch::ranksBefore);
+            }
+        } else if (BookmarkSearch::ranksBefore(result, kept.front())) {
+            std::pop_heap(kept.begin(), kept.end(), BookmarkSearch::ranksBefore);
+            kept.back() = result;
+            std::push_heap(kept.begin(), kept.end(), BookmarkSearch::ranksBefore);
+        }
+    };
+    const auto scoreRange = [&candidates, &score, &add](std::size_t begin, std::size_t end, Results &kept) {
+        std::size_t matched = 0;
+        for (std::size_t i = begin; i < end; ++i) {
+            const float relevance = score(*candidates[i]);
+            if (relevance > 0) {
+                ++matched;
+                add(kept, SearchResult{candidates[i], relevance});
+            }
+        }
+        return matched;
+    };
+
+    std::pmr::memory_resource *resource = results.get_allocator().resource();
+    if (candidates.size() < std::size_t(BookmarkSearch::parallelThreshold())) {
+        if (limit <= 0) {
+            return scoreRange(0, candidates.size(), results);
+        }
+        Results kept(resource);
+        kept.reserve(std::min(keep, candidates.size()));
+        const std::size_t matched = scoreRange(0, candidates.size(), kept);
+        results.insert(results.end(), kept.cbegin(), kept.cend());
+        return matched;
+    }
+
+    // The buffers are allocated up front, the arena of this thread must not be used by the others
+    const int chunks = int((candidates.size() + BookmarkSearch::ChunkSize - 1) / BookmarkSearch::ChunkSize);
+    std::pmr::vector<Results> chunkResults(resource);
+    chunkResults.reserve(chunks);
+    for (int chunk = 0; chunk < chunks; ++chunk) {
+        chunkResults.emplace_back().reserve(std::min<std::size_t>(keep, BookmarkSearch::ChunkSize));
+    }
+    std::pmr::vector<std::size_t> chunkMatched(chunks, 0, resource);
+    ParallelFor::run(chunks, [&](int chunk) {
+        const std::size_t begin = std::size_t(chunk) * BookmarkSearch::ChunkSize;
+        const std::size_t end = std::min(candidates.size(), begin + BookmarkSearch::ChunkSize);
+        chunkMatched[chunk] = scoreRange(begin, end, chunkResults[chunk]);
+    });
+
+    std::size_t matched = 0;
+    for (int chunk = 0; chunk < chunks; ++chunk) {
+        matched += chunkMatched[chunk];
+        results.insert(results.end(), chunkResults[chunk].cbegin(), chunkResults[chunk].cend());
+    }
+    return matched;
+}
+
+bool BookmarkSearch::parseQuery(const QString &term, QString &filter)
+{
+    static const QRegularExpression filterRegex(R"(^(?:b|bookmark\w*)(?: (.*))?$)", QRegularExpression::CaseInsensitiveOption);
+    const QRegularExpressionMatch match = filterRegex.match(term);
+    if (!match.hasMatch()) {
+        return false;
+    }
+    filter = match.captured(1).trimmed();
+    return true;
+}
+
+const BookmarkKeyword *BookmarkSearch::resolveKeyword(const BookmarkIndex &index, const QString &filter, QString &url)
+{
+    const int separator = filter.indexOf(QLatin1Char(' '));
+    const QString word = separator == -1 ? filter : filter.left(separator);
+    const BookmarkKeyword *keyword = index.keyword(word.toLower());
+    if (!keyword) {
+        return nullptr;
+    }
+    const QString parameter = separator == -1 ? QString() : filter.mid(separator + 1).trimmed();
+    url = keyword->url;
+    url.replace(QLatin1String("%s"), QString::fromLatin1(QUrl::toPercentEncoding(parameter, "/")));
+    url.replace(QLatin1String("%S"), parameter);
+    return keyword;
+}
+
+QVector<SearchResult> BookmarkSearch::search(const BookmarkIndex &index, const QString &filter)
+{
+    return search(index, BookmarkQuery::parse(filter));
+}
+
+QVector<SearchResult> BookmarkSearch::search(const BookmarkIndex &index, const BookmarkQuery &query)
+{
+    QueryArena::Scope arenaScope;
+    Results results(QueryArena::resource());
+    search(index, query, results);
+    return QVector<SearchResult>(results.cbegin(), results.cend());
+}
+
+/**
+ * Add the word start and acronym matches that the scan did not find, or found with a lower relevance
+ */
+static void mergeWordStarts(const BookmarkIndex &index, const QVector<WordStartIndex::Entry> &entries, BookmarkSearch::Results &results)
+{
+    std::pmr::memory_resource *resource = results.get_allocator().resource();
+    std::pmr::unordered_map<qint64, int> positions(resource);
+    positions.reserve(entries.size());
+    for (int i = 0; i < entries.size(); ++i) {
+        positions.emplace(entries.at(i).id, i);
+    }
+    std::pmr::vector<bool> found(entries.size(), false, resource);
+    for (SearchResult &result : results) {
+        if (const auto it = positions.find(result.bookmark->id); it != positions.cend()) {
+            result.relevance = std::max(result.relevance, entries.at(it->second).relevance);
+            found[it->second] = true;
+        }
+    }
+    for (int i = 0; i < entries.size(); ++i) {
+        if (!found[i]) {
+            if (const Bookmark *bookmark = index.find(entries.at(i).id)) {
+                results.push_back(SearchResult{bookmark, entries.at(i).relevance});
+            }
+        }
+    }
+}
+
+/**
+ * The operators of the query select the candidates, the terms are scored last since that is the expensive part.
+ * A single short term without operators is answered from the word start lists if they have enough entries that
+ * start a title. Below that the scan could find better ones, e.g. a title containing the term ranks above a host
+ * or an acronym that starts with it.
+ */
+void BookmarkSearch::search(const BookmarkIndex &index, const BookmarkQuery &query, Results &results, int limit)
+{
+    std::pmr::memory_resource *resource = results.get_allocator().resource();
+    const QVector<WordStartIndex::Entry> *wordStarts = nullptr;
+    if (query.terms.size() == 1 && query.excluded.isEmpty() && query.sites.isEmpty() && query.folders.isEmpty() && query.tags.isEmpty()) {
+        std::pmr::u16string folded(resource);
+        foldCase(query.terms.first(), folded);
+        wordStarts = index.wordStarts().entries(QStringView(folded.data(), qsizetype(folded.size())));
+        if (wordStarts && limit > 0 && folded.size() <= std::size_t(WordStartIndex::MaxPrefixLength) && wordStarts->size() >= limit
+            && wordStarts->at(limit - 1).relevance >= WordStartIndex::TitleStartRelevance) {
+            results.clear();
+            for (int i = 0; i < limit; ++i) {
+                if (const Bookmark *bookmark = index.find(wordStarts->at(i).id)) {
+                    results.push_back(SearchResult{bookmark, wordStarts->at(i).relevance});
+                }
+            }
+            std::sort(results.begin(), results.end(), ranksBefore);
+            return;
+        }
+    }
+
+    Candidates candidates(resource);
+    query.filter(index, candidates);
+    std::pmr::vector<ScoringTerm> terms(resource);
+    terms.reserve(query.terms.size());
+    for (const QString &text : query.terms) {
+        ScoringTerm &term = terms.emplace_back(resource);
+        term.text = text;
+        foldCase(text, term.folded);
+        // Phrases are compared against the URL as a whole, words against its tokens
+        term.phrase = text.contains(QLatin1Char(' '));
+        if (!term.phrase) {
+            urlSearch(index, text, term.urlScores);
+        }
+    }
+    const QString text = query.text();
+    std::pmr::u16string foldedText(resource);
+    foldCase(text, foldedText);
+
+    results.clear();
+    // The typo tolerant search needs all matches of the substring search to leave them out
+    const int keep = limit > 0 ? std::max(limit, TypoSearchThreshold) : 0;
+    const std::size_t matched = rank(
+        candidates,
+        [&terms, &foldedText](const Bookmark &bookmark) {
+            return score(bookmark, terms, foldedText);
+        },
+        keep,
+        results);
+
+    if (!query.terms.isEmpty() && matched < std::size_t(TypoSearchThreshold)) {
+        Candidates unmatched(resource);
+        unmatched.reserve(candidates.size() - results.size());
+        for (const Bookmark *bookmark : candidates) {
+            const bool found = std::any_of(results.cbegin(), results.cend(), [bookmark](const SearchResult &result) {
+                return result.bookmark == bookmark;
+            });
+            if (!found) {
+                unmatched.push_back(bookmark);
+            }
+        }
+        typoSearch(unmatched, text, results, keep);
+    }
+    if (wordStarts) {
+        mergeWordStarts(index, *wordStarts, results);
+    }
+
+    if (limit > 0 && results.size() > std::size_t(limit)) {
+        std::partial_sort(results.begin(), results.begin() + limit, results.end(), ranksBefore);
+        results.resize(limit);
+    } else {
+        std::sort(results.begin(), results.end(), ranksBefore);
+    }
+}
+
+QVector<FolderResult> BookmarkSearch::folderSearch(const BookmarkIndex &index, const BookmarkQuery &query, int limit)
+{
+    QVector<FolderResult> results;
+    if (!query.excluded.isEmpty() || !query.sites.isEmpty() || !query.tags.isEmpty()) {
+        return results;
+    }
+    const auto add = [&](const QString &key, float relevance) {
+        const QVector<const Bookmark *> bookmarks = index.bookmarksInFolder(key);
+        if (bookmarks.size() >= MinFolderSize) {
+            results.append(FolderResult{bookmarks.first()->folder, bookmarks, relevance});
+        }
+    };
+    if (!query.folders.isEmpty()) {
+        if (query.terms.isEmpty()) {
+            for (const QString &folder : query.folders) {
+                add(folder, 1.0);
+            }
+        }
+    } else if (const QString text = query.text().toLower(); !text.isEmpty()) {
+        for (const QString &key : index.folderKeys()) {
+            if (key == text) {
+                add(key, 0.9);
+            } else if (key.startsWith(text)) {
+                add(key, 0.8);
+            } else if (key.contains(text)) {
+                add(key, 0.6);
+            }
+        }
+    }
+    std::sort(results.begin(), results.end(), [](const FolderResult &a, const FolderResult &b) {
+        return a.relevance != b.relevance ? a.relevance > b.relevance : a.title < b.title;
+    });
+    if (limit > 0 && results.size() > limit) {
+        results.resize(limit);
+    }
+    return results;
+}
+
+bool BookmarkSearch::ranksBefore(const SearchResult &a, const SearchResult &b)
+{
+    if (a.relevance != b.relevance) {
+        return a.relevance > b.relevance;
+    }
+    if (a.bookmark->title != b.bookmark->title) {
+        return a.bookmark->title < b.bookmark->title;
+    }
+    return a.bookmark->id < b.bookmark->id;
+}
+
+int BookmarkSearch::parallelThreshold()
+{
+    return s_parallelThreshold.load(std::memory_order_relaxed);
+}
+
+void BookmarkSearch::setParallelThreshold(int candidates)
+{
+    s_parallelThreshold.store(candidates, std::memory_order_relaxed);
+}
+
+static bool startsWithFolded(const QString &text, std::u16string_view prefix)
+{
+    return std::size_t(text.size()) >= prefix.size() && std::equal(prefix.cbegin(), prefix.cend(), reinterpret_cast<const char16_t *>(text.utf16()));
+}
+
+/**
+ * Average relevance of the terms, 0 if one of them is not found. A title that starts with the whole
+ * query ranks like a single term that is a prefix of the title.
+ */
+float BookmarkSearch::score(const Bookmark &bookmark, const std::pmr::vector<ScoringTerm> &terms, std::u16string_view foldedText)
+{
+    if (terms.empty()) {
+        return 0.8;
+    }
+    if (terms.size() > 1 && startsWithFolded(bookmark.foldedTitle, foldedText)) {
+        return 1.0;
+    }
+    float sum = 0;
+    for (const ScoringTerm &term : terms) {
+        float relevance = 0;
+        if (startsWithFolded(bookmark.foldedTitle, term.folded)) {
+            relevance = 1.0;
+        } else if (containsFolded(bookmark.foldedTitle, term.folded)) {
+            relevance = 0.9;
+        } else if (const auto it = term.urlScores.find(bookmark.id); it != term.urlScores.cend()) {
+            relevance = it->second;
+        } else if (term.phrase && bookmark.url.contains(term.text, Qt::CaseInsensitive)) {
+            relevance = 0.8;
+        } else {
+            return 0;
+        }
+        sum += relevance;
+    }
+    return sum / terms.size();
+}
+
+void BookmarkSearch::foldCase(QStringView text, std::pmr::u16string &folded)
+{
+    folded.resize(text.size());
+    const QChar *data = text.data();
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        // Characters outside of the BMP have case foldings too, e.g. Deseret
+        if (data[i].isHighSurrogate() && i + 1 < text.size() && data[i + 1].isLowSurrogate()) {
+            const uint codePoint = QChar::toCaseFolded(QChar::surrogateToUcs4(data[i], data[i + 1]));
+            folded[i] = QChar::highSurrogate(codePoint);
+            folded[++i] = QChar::lowSurrogate(codePoint);
+            continue;
+        }
+        folded[i] = data[i].toCaseFolded().unicode();
+    }
+}
+
+bool BookmarkSearch::containsFolded(const QString &text, std::u16string_view needle)
+{
+    return SubstringSearch::contains(reinterpret_cast<const char16_t *>(text.utf16()), text.size(), needle.data(), needle.size());
+}
+
+int BookmarkSearch::maxEdits(int wordLength)
+{
+    if (wordLength < 3) {
+        return 0;
+    }
+    return wordLength <= 5 ? 1 : 2;
+}
+
+void BookmarkSearch::typoSearch(const Candidates &candidates, const QString &filter, Results &results, int limit)
+{
+    static const QRegularExpression separator(QStringLiteral("[^\\p{L}\\p{N}]+"));
+    const QStringList queryWords = filter.toLower().split(separator, Qt::SkipEmptyParts);
+    // Words without any tolerance are better handled by the substring search
+    const bool hasTolerance = std::any_of(queryWords.cbegin(), queryWords.cend(), [](const QString &word) {
+        return maxEdits(word.size()) > 0;
+    });
+    if (queryWords.isEmpty() || !hasTolerance) {
+        return;
+    }
+
+    std::pmr::vector<EditDistance> patterns(results.get_allocator().resource());
+    patterns.reserve(queryWords.size());
+    for (const QString &word : queryWords) {
+        patterns.emplace_back(reinterpret_cast<const char16_t *>(word.utf16()), word.size());
+    }
+
+    rank(
+        candidates,
+        [&patterns](const Bookmark &bookmark) {
+            int totalEdits = 0;
+            for (const EditDistance &pattern : patterns) {
+                const int allowed = maxEdits(pattern.patternLength());
+                int best = allowed + 1;
+                for (const QString &word : bookmark.words) {
+                    best = std::min(best, pattern.prefixDistance(reinterpret_cast<const char16_t *>(word.utf16()), word.size(), allowed));
+                    if (best == 0) {
+                        break;
+                    }
+                }
+                if (best > allowed) {
+                    return 0.0f;
+                }
+                totalEdits += best;
+            }
+            return std::max(0.5f, 0.7f - 0.05f * totalEdits);
+        },
+        limit,
+        results);
+}
+
+QHash<qint64, float> BookmarkSearch::urlSearch(const BookmarkIndex &index, const QString &filter)
+{
+    QueryArena::Scope arenaScope;
+    UrlScores scores(QueryArena::resource());
+    urlSearch(index, filter, scores);
+    QHash<qint64, float> result;
+    result.reserve(scores.size());
+    for (const auto &[id, score] : scores) {
+        result.insert(id, score);
+    }
+    return result;
+}
+
+void BookmarkSearch::urlSearch(const BookmarkIndex &index, const QString &filter, UrlScores &scores)
+{
+    scores.clear();
+    const QStringList words = UrlTokenizer::words(filter);
+    // Best field of the current word per bookmark
+    UrlScores wordScores(scores.get_allocator().resource());
+    for (int i = 0; i < words.size(); ++i) {
+        wordScores.clear();
+        index.forEachUrlPosting(words.at(i), [&wordScores, &scores, i](const UrlPosting &posting) {
+            if (i > 0 && scores.find(posting.bookmarkId) == scores.cend()) {
+                return;
+            }
+            float &score = wordScores[posting.bookmarkId];
+            score = std::max(score, UrlTokenizer::weight(posting.field));
+        });
+        if (i == 0) {
+            scores.swap(wordScores);
+            continue;
+        }
+        // Every word has to be found in the URL
+        for (auto it = scores.begin(); it != scores.end();) {
+            const auto wordScore = wordScores.find(it->first);
+            if (wordScore == wordScores.cend()) {
+                it = scores.erase(it);
+            } else {
+                it->second += wordScore->second;
+                ++it;
+            }
+        }
+        if (scores.empty()) {
+            break;
+        }
+    }
+    for (auto &entry : scores) {
+        entry.second /= words.size();
+    }
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "BookmarkIndex.h"
+#include "BookmarkQuery.h"
+
+#include <QHash>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct SearchResult {
+    const Bookmark *bookmark = nullptr;
+    float relevance = 0;
+};
+
+/**
+ * Folder whose bookmarks are opened together
+ */
+struct FolderResult {
+    QString title;
+    QVector<const Bookmark *> bookmarks; // In the order of the folder
+    float relevance = 0;
+
+    QStringList urls() const;
+    /**
+     * As shown in KRunner and by zen-bookmark-query
+     */
+    QString text() const;
+};
+
+using UrlScores = std::pmr::unordered_map<qint64, float>;
+
+/**
+ * Term of a BookmarkQuery prepared once per search, the buffers come from the memory resource of the search
+ */
+struct ScoringTerm {
+    explicit ScoringTerm(std::pmr::memory_resource *resource)
+        : folded(resource)
+        , urlScores(resource)
+    {
+    }
+
+    QString text;
+    std::pmr::u16string folded;
+    bool phrase = false; // Contains whitespace, compared against the URL as a whole
+    UrlScores urlScores; // From urlSearch(), empty for phrases
+};
+
+/**
+ * Query parsing and ranking, shared by the runner and the zen-bookmark-query tool
+ */
+class BookmarkSearch
+{
+public:
+    using Candidates = std::pmr::vector<const Bookmark *>;
+    using Results = std::pmr::vector<SearchResult>;
+
+    /**
+     * Extract the filter from a KRunner query like "b github", returns false if the query is not for bookmarks
+     */
+    static bool parseQuery(const QString &term, QString &filter);
+
+    /**
+     * Resolve a keyword shortcut like "gh rust-lang/rust". The first word is looked up as keyword, %s in its URL
+     * is replaced with the percent encoded rest of the filter and %S with the rest as typed. Slashes are kept,
+     * so that "gh owner/repo" works with a path template.
+     * Returns nullptr if the first word is not a keyword.
+     */
+    static const BookmarkKeyword *resolveKeyword(const BookmarkIndex &index, const QString &filter, QString &url);
+
+    /**
+     * Bookmarks matching the filter, ordered by relevance and title. See BookmarkQuery for the syntax.
+     * The results point into the index, it must outlive them.
+     */
+    static QVector<SearchResult> search(const BookmarkIndex &index, const QString &filter);
+    static QVector<SearchResult> search(const BookmarkIndex &index, const BookmarkQuery &query);
+
+    /**
+     * Same as above without heap allocations: the results and every scratch buffer come from the memory resource
+     * of results, usually the QueryArena of the thread. They are only valid until the arena is reset.
+     * With a limit only the best limit results are kept. A single term of up to two characters is then answered
+     * from the word start lists of the index: the limit best entries by relevance and frecency, see WordStartIndex.
+     */
+    static void search(const BookmarkIndex &index, const BookmarkQuery &query, Results &results, int limit = 0);
+
+    /**
+     * Folders to open as a whole: the ones named by folder: if it is the only operator and there are no terms,
+     * otherwise the ones whose title contains the terms. Folders with less than MinFolderSize bookmarks are
+     * skipped, at most limit are returned.
+     */
+    static QVector<FolderResult> folderSearch(const BookmarkIndex &index, const BookmarkQuery &query, int limit);
+
+    /**
+     * Append the candidates where every query word is within a few edits of a word (or word prefix)
+     * of the title or host, at most limit of them. This is the fallback if the substring search finds too little.
+     */
+    static void typoSearch(const Candidates &candidates, const QString &filter, Results &results, int limit = 0);
+
+    /**
+     * Order of the results: relevance, then title and id so that the order does not depend on the scoring threads
+     */
+    static bool ranksBefore(const SearchResult &a, const SearchResult &b);
+
+    /**
+     * Candidate lists of at least this size are scored in chunks on several threads, see ParallelFor.
+     * Below it the thread handoff costs more than it saves.
+     */
+    static int parallelThreshold();
+    static void setParallelThreshold(int candidates);
+
+    /**
+     * Relevance of the bookmarks whose URL tokens contain all words of the filter, using the field weights
+     * of UrlTokenizer. Words are matched against token prefixes.
+     */
+    static QHash<qint64, float> urlSearch(const BookmarkIndex &index, const QString &filter);
+    static void urlSearch(const BookmarkIndex &index, const QString &filter, UrlScores &scores);
+
+    /**
+     * Average relevance of the terms, 0 if one of them is not found
+     */
+    static float score(const Bookmark &bookmark, const std::pmr::vector<ScoringTerm> &terms, std::u16string_view foldedText);
+
+    /**
+     * Case folding like QString::toCaseFolded() into a buffer of the caller
+     */
+    static void foldCase(QStringView text, std::pmr::u16string &folded);
+
+    /**
+     * Substring test of case folded strings, see SubstringSearch
+     */
+    static bool containsFolded(const QString &text, std::u16string_view needle);
+
+    /**
+     * Edits that are tolerated for a query word of the given length
+     */
+    static int maxEdits(int wordLength);
+
+    // KRunner shows a few dozen matches at most, the runner and zen-bookmark-query stop there
+    static constexpr int MatchLimit = 50;
+    // Opening a whole folder is rarely wanted for more than the best fitting ones
+    static constexpr int FolderMatchLimit = 3;
+    // Opening a single bookmark is what the regular results are for
+    static constexpr int MinFolderSize = 2;
+    // The typo tolerant pass runs if the substring search found less results
+    static constexpr int TypoSearchThreshold = 3;
+    // Scoring takes about 65 ns per candidate, a chunk keeps a thread busy for much longer than claiming it takes
+    static constexpr int ChunkSize = 2048;
+    // Dispatching to the pool costs tens of microseconds, from four chunks on that is clearly worth it
+    static constexpr int DefaultParallelThreshold = 4 * ChunkSize;
+};
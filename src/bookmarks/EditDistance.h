@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+/**
+ * Bounded Damerau-Levenshtein distance (optimal string alignment) of a fixed pattern against many texts.
+ *
+ * Uses the bit-parallel algorithm of Myers with the transposition extension of Hyyrö: one column of the
+ * dynamic programming matrix is encoded in the bit vectors VP/VN, so each text character costs a few word
+ * operations instead of O(pattern length). Patterns are limited to 64 characters.
+ */
+class EditDistance
+{
+public:
+    static constexpr int MaxPatternLength = 64;
+
+    EditDistance(const char16_t *pattern, int length)
+        : m_length(std::min(length, MaxPatternLength))
+    {
+        m_ascii.fill(0);
+        for (int i = 0; i < m_length; ++i) {
+            const char16_t c = pattern[i];
+            if (c < 128) {
+                m_ascii[c] |= uint64_t(1) << i;
+                continue;
+            }
+            const auto it = std::find_if(m_other.begin(), m_other.end(), [c](const auto &entry) {
+                return entry.first == c;
+            });
+            if (it == m_other.end()) {
+                m_other.emplace_back(c, uint64_t(1) << i);
+            } else {
+                it->second |= uint64_t(1) << i;
+            }
+        }
+    }
+
+    int patternLength() const
+    {
+        return m_length;
+    }
+
+    /**
+     * Distance between the pattern and the whole text, or maxDistance + 1 if it exceeds maxDistance
+     */
+    int distance(const char16_t *text, int length, int maxDistance) const
+    {
+        if (std::abs(length - m_length) > maxDistance) {
+            return maxDistance + 1;
+        }
+        return compute(text, length, maxDistance, false);
+    }
+
+    /**
+     * Smallest distance between the pattern and any prefix of the text, this matches partially typed words
+     */
+    int prefixDistance(const char16_t *text, int length, int maxDistance) const
+    {
+        // Longer prefixes need at least one deletion per additional character
+        return compute(text, std::min(length, m_length + maxDistance), maxDistance, true);
+    }
+
+private:
+    int compute(const char16_t *text, int length, int maxDistance, bool prefix) const
+    {
+        if (m_length == 0) {
+            return prefix ? 0 : std::min(length, maxDistance + 1);
+        }
+        const uint64_t mask = m_length == 64 ? ~uint64_t(0) : (uint64_t(1) << m_length) - 1;
+        const uint64_t lastBit = uint64_t(1) << (m_length - 1);
+        uint64_t vp = mask;
+        uint64_t vn = 0;
+        uint64_t d0 = 0;
+        uint64_t previousEq = 0;
+        int score = m_length;
+        int best = score;
+        for (int j = 0; j < length; ++j) {
+            const uint64_t eq = peq(text[j]);
+            const uint64_t transposition = (((~d0) & eq) << 1) & previousEq;
+            d0 = ((((eq & vp) + vp) ^ vp) | eq | vn | transposition) & mask;
+            const uint64_t hp = vn | ~(d0 | vp);
+            const uint64_t hn = d0 & vp;
+            if (hp & lastBit) {
+                ++score;
+            } else if (hn & lastBit) {
+                --score;
+            }
+            best = std::min(best, score);
+            // The remaining characters can lower the distance by at most one each
+            if (!prefix && score - (length - j - 1) > maxDistance) {
+                return maxDistance + 1;
+            }
+            const uint64_t x = (hp << 1) | 1;
+            vn = x & d0;
+            vp = ((hn << 1) | ~(x | d0)) & mask;
+            previousEq = eq;
+        }
+        const int result = prefix ? best : score;
+        return result <= maxDistance ? result : maxDistance + 1;
+    }
+
+    uint64_t peq(char16_t c) const
+    {
+        if (c < 128) {
+            return m_ascii[c];
+        }
+        for (const auto &entry : m_other) {
+            if (entry.first == c) {
+                return entry.second;
+            }
+        }
+        return 0;
+    }
+
+    int m_length;
+    std::array<uint64_t, 128> m_ascii;
+    std::vector<std::pair<char16_t, uint64_t>> m_other;
+};
@@ -0,0 +1,103 @@
+#include "IndexUpdater.h"
+
+#include "PlacesDatabase.h"
+
+#include <QMutexLocker>
+
+IndexUpdater::IndexUpdater()
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+void IndexUpdater::setSourcePath(const QString &sourcePath)
+{
+    if (sourcePath != this->sourcePath()) {
+        m_sourcePath.publish(std::make_shared<const QString>(sourcePath));
+    }
+}
+
+QString IndexUpdater::sourcePath() const
+{
+    const auto sourcePath = m_sourcePath.acquire();
+    return sourcePath ? *sourcePath : QString();
+}
+
+void IndexUpdater::scheduleRefresh(bool rebuild)
+{
+    const qint64 modified = PlacesDatabase::sourceModified(sourcePath()).toMSecsSinceEpoch();
+    if (!rebuild && modified == m_indexedSourceModified.load()) {
+        return;
+    }
+    bool expected = false;
+    if (!m_refreshRunning.compare_exchange_strong(expected, true) && !rebuild) {
+        return;
+    }
+    m_pool.start([this, modified, rebuild]() {
+        refresh(modified, rebuild);
+        m_refreshRunning = false;
+    });
+}
+
+PlacesReader::BuildStats IndexUpdater::lastBuild() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_lastBuild;
+}
+
+void IndexUpdater::runInBackground(const std::function<void()> &task)
+{
+    m_pool.start(task);
+}
+
+void IndexUpdater::release()
+{
+    m_snapshot.publish(nullptr);
+    m_indexedSourceModified = 0;
+}
+
+void IndexUpdater::waitForDone()
+{
+    m_pool.waitForDone();
+}
+
+/**
+ * Apply the database changes to a copy of the current generation and publish it.
+ * For the first load and a rebuild the tables are read in parallel into an empty index instead.
+ */
+void IndexUpdater::refresh(qint64 sourceModified, bool rebuild)
+{
+    PlacesDatabase places(sourcePath(), QStringLiteral("zen_bookmarks_"));
+    if (!places.open()) {
+        return;
+    }
+    const auto current = m_snapshot.acquire();
+    std::shared_ptr<BookmarkIndex> next;
+    PlacesReader::SyncResult result;
+    if (current && !rebuild) {
+        next = std::make_shared<BookmarkIndex>(*current);
+        result = PlacesReader(places.database()).sync(*next);
+    } else {
+        next = std::make_shared<BookmarkIndex>();
+        PlacesReader::BuildStats build;
+        if (PlacesReader::readAllParallel(places, *next, &build)) {
+            result = PlacesReader::SyncResult::Rebuilt;
+            QMutexLocker locker(&m_mutex);
+            m_lastBuild = build;
+        } else {
+            result = PlacesReader::SyncResult::Failed;
+        }
+    }
+    if (result == PlacesReader::SyncResult::Failed) {
+        return;
+    }
+    m_indexedSourceModified = sourceModified;
+    if (result == PlacesReader::SyncResult::Unchanged) {
+        return;
+    }
+    ++(result == PlacesReader::SyncResult::Rebuilt ? m_rebuilds : m_patches);
+    next->generation = current ? current->generation + 1 : 1;
+    m_snapshot.publish(next);
+    if (m_published) {
+        m_published(*next);
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "BookmarkIndex.h"
+#include "PlacesReader.h"
+#include "SnapshotPublisher.h"
+
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+/**
+ * Keeps a BookmarkIndex in sync with places.sqlite, shared by the runner and zen-bookmark-daemon.
+ * Refreshes run on a single background thread and publish a new generation, queries keep using the
+ * published one meanwhile and never wait for the database.
+ */
+class IndexUpdater
+{
+public:
+    IndexUpdater();
+
+    /**
+     * Set by the configuration, calls must not overlap. Every query reads it, it is published like the index.
+     */
+    void setSourcePath(const QString &sourcePath);
+    QString sourcePath() const;
+
+    std::shared_ptr<const BookmarkIndex> acquire() const
+    {
+        return m_snapshot.acquire();
+    }
+
+    /**
+     * Start a background refresh if Zen wrote to the database since the last sync.
+     * A rebuild is always scheduled, it runs after a refresh that is already running.
+     */
+    void scheduleRefresh(bool rebuild = false);
+
+    /**
+     * Run the task on the thread of the refreshes, after the ones that are scheduled
+     */
+    void runInBackground(const std::function<void()> &task);
+
+    /**
+     * Drop the index, the next refresh reads it again. Only call this from runInBackground().
+     */
+    void release();
+
+    /**
+     * Block until the scheduled refreshes and tasks are done
+     */
+    void waitForDone();
+
+    /**
+     * Called on the background thread after a changed index was published
+     */
+    void setPublishedCallback(const std::function<void(const BookmarkIndex &)> &callback)
+    {
+        m_published = callback;
+    }
+
+    quint64 patches() const
+    {
+        return m_patches;
+    }
+    quint64 rebuilds() const
+    {
+        return m_rebuilds;
+    }
+    /**
+     * Timings of the last full load
+     */
+    PlacesReader::BuildStats lastBuild() const;
+
+private:
+    void refresh(qint64 sourceModified, bool rebuild);
+
+    SnapshotPublisher<QString> m_sourcePath;
+    mutable QMutex m_mutex;
+    PlacesReader::BuildStats m_lastBuild;
+
+    // Refresh and release publish generations, they run one at a time on the pool
+    SnapshotPublisher<BookmarkIndex> m_snapshot;
+    std::atomic<qint64> m_indexedSourceModified{0};
+    std::atomic<bool> m_refreshRunning{false};
+    std::atomic<quint64> m_patches{0};
+    std::atomic<quint64> m_rebuilds{0};
+    std::function<void(const BookmarkIndex &)> m_published;
+
+    // Declared last so that it is destroyed first and waits for a running refresh
+    QThreadPool m_pool;
+};
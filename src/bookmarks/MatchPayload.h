@@ -0,0 +1,57 @@
+#pragma once
+
+#include "BookmarkIndex.h"
+
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+/**
+ * Data attached to a KRunner match. Bookmarks are referenced by their id and resolved from the current snapshot
+ * in run(), so that creating a match does not allocate: a qint64 and a shared QString are stored in place.
+ * Matches that are not in the index, like tabs and keywords, carry their URL instead, folders the list of their URLs.
+ */
+class MatchPayload
+{
+public:
+    static QVariant forBookmark(const Bookmark &bookmark)
+    {
+        return QVariant(static_cast<qlonglong>(bookmark.id));
+    }
+    static QVariant forUrl(const QString &url)
+    {
+        return QVariant(url);
+    }
+    static QVariant forUrls(const QStringList &urls)
+    {
+        return QVariant(urls);
+    }
+
+    /**
+     * URL of the match, empty if the bookmark was removed or the index released since the match was created
+     */
+    static QString url(const QVariant &data, const BookmarkIndex *index)
+    {
+        if (data.userType() == QMetaType::QString) {
+            return data.toString();
+        }
+        if (data.userType() == QMetaType::LongLong && index) {
+            if (const Bookmark *bookmark = index->find(data.toLongLong())) {
+                return bookmark->url;
+            }
+        }
+        return QString();
+    }
+
+    /**
+     * URLs to open for the match, a single one unless it is a folder
+     */
+    static QStringList urls(const QVariant &data, const BookmarkIndex *index)
+    {
+        if (data.userType() == QMetaType::QStringList) {
+            return data.toStringList();
+        }
+        const QString single = url(data, index);
+        return single.isEmpty() ? QStringList() : QStringList{single};
+    }
+};
@@ -0,0 +1,68 @@
+#include "ParallelFor.h"
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace
+{
+class Helper : public QRunnable
+{
+public:
+    Helper(const std::function<void()> &work, QSemaphore &done)
+        : m_work(work)
+        , m_done(done)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        m_work();
+        m_done.release();
+    }
+
+private:
+    const std::function<void()> &m_work;
+    QSemaphore &m_done;
+};
+}
+
+void ParallelFor::run(int chunks, const std::function<void(int)> &function)
+{
+    std::atomic<int> next{0};
+    const std::function<void()> work = [&next, chunks, &function]() {
+        for (int chunk = next++; chunk < chunks; chunk = next++) {
+            function(chunk);
+        }
+    };
+    const int helperCount = std::min(chunks, QThread::idealThreadCount()) - 1;
+    if (helperCount <= 0) {
+        work();
+        return;
+    }
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    QSemaphore done;
+    std::vector<std::unique_ptr<Helper>> helpers;
+    helpers.reserve(helperCount);
+    for (int i = 0; i < helperCount; ++i) {
+        helpers.push_back(std::make_unique<Helper>(work, done));
+        pool->start(helpers.back().get());
+    }
+    work();
+    // Helpers that still wait in the queue have nothing left to do
+    int started = 0;
+    for (const auto &helper : helpers) {
+        if (!pool->tryTake(helper.get())) {
+            ++started;
+        }
+    }
+    done.acquire(started);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <functional>
+
+/**
+ * Runs function(chunk) for every chunk in [0, chunks) on the calling thread and helpers of the global thread pool.
+ * The chunks are claimed from a shared counter, a thread that is done takes the next one, so chunks that take
+ * longer balance out. Helpers that did not start by the time the calling thread runs out of chunks are taken
+ * back from the pool, a busy pool does not delay the caller.
+ * The function is called concurrently, it must not allocate from the QueryArena of the caller.
+ */
+class ParallelFor
+{
+public:
+    static void run(int chunks, const std::function<void(int)> &function);
+};
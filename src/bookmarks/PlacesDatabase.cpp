@@ -0,0 +1,388 @@
+#include "PlacesDatabase.h"
+
+#include "firefox_debug.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QSet>
+#include <QSqlError>
+#include <QStandardPaths>
+#include <QThread>
+
+#include <atomic>
+#include <climits>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+static std::atomic<int> copyCounter{0};
+static std::atomic<int> snapshotCounter{0};
+
+// Modification times have the granularity of the kernel clock tick, a write in the same tick as the
+// first check would not change them
+static constexpr qint64 racyIntervalMs = 20;
+// The magic, version, page size, checkpoint sequence number and salts
+static constexpr int walHeaderSize = 24;
+
+static std::atomic<quint64> s_snapshots{0};
+static std::atomic<quint64> s_reuses{0};
+static std::atomic<quint64> s_bytesCloned{0};
+static std::atomic<quint64> s_bytesCopied{0};
+static std::atomic<quint64> s_lastBytesCopied{0};
+
+namespace
+{
+void removeFiles(const QString &path)
+{
+    QFile::remove(path);
+    QFile::remove(path + "-wal");
+    QFile::remove(path + "-shm");
+}
+
+/**
+ * Copy-on-write clone, only possible within one filesystem that supports it like Btrfs or XFS
+ */
+bool cloneFile(const QString &source, const QString &target)
+{
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+    const int in = ::open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return false;
+    }
+    const int out = ::open(QFile::encodeName(target).constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (out < 0) {
+        ::close(in);
+        return false;
+    }
+    const bool cloned = ::ioctl(out, FICLONE, in) == 0;
+    ::close(out);
+    ::close(in);
+    if (!cloned) {
+        QFile::remove(target);
+    }
+    return cloned;
+#else
+    Q_UNUSED(source)
+    Q_UNUSED(target)
+    return false;
+#endif
+}
+
+/**
+ * The runtime dir is a tmpfs on most systems, the cache dir is only used for clones since a copy there
+ * would be written to disk
+ */
+QStringList copyDirectories()
+{
+    QStringList directories;
+    const QString runtime = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (!runtime.isEmpty()) {
+        directories.append(runtime);
+    }
+    directories.append(QDir::tempPath());
+    return directories;
+}
+
+/**
+ * Clone the database and its WAL if possible, copy them otherwise. The database goes first, a checkpoint
+ * that runs meanwhile modifies it and is noticed by the caller. Incomplete transactions at the end of the
+ * WAL are ignored by SQLite, their frames have no commit marker. The -shm file is not copied, SQLite
+ * rebuilds it from the WAL when the copy is opened.
+ */
+bool copyFiles(const QString &sourcePath, const QString &fileName, QString &copyPath, quint64 &cloned, quint64 &copied)
+{
+    const QString walPath = sourcePath + "-wal";
+    for (const QString &directory : PlacesDatabase::snapshotDirectories()) {
+        const QString path = QDir(directory).filePath(fileName);
+        if ((!QDir(directory).exists() && !QDir().mkpath(directory)) || !cloneFile(sourcePath, path)) {
+            continue;
+        }
+        cloned += QFileInfo(path).size();
+        if (QFile::exists(walPath)) {
+            if (cloneFile(walPath, path + "-wal")) {
+                cloned += QFileInfo(path + "-wal").size();
+            } else if (QFile::copy(walPath, path + "-wal")) {
+                copied += QFileInfo(path + "-wal").size();
+            } else {
+                // The WAL may disappear while copying when Zen closes the database
+                removeFiles(path);
+                return false;
+            }
+        }
+        copyPath = path;
+        return true;
+    }
+    for (const QString &directory : copyDirectories()) {
+        const QString path = QDir(directory).filePath(fileName);
+        if (!QFile::copy(sourcePath, path)) {
+            continue;
+        }
+        // The WAL contains the recent changes that are not checkpointed yet
+        if (QFile::exists(walPath) && !QFile::copy(walPath, path + "-wal")) {
+            removeFiles(path);
+            return false;
+        }
+        copied += QFileInfo(path).size() + QFileInfo(path + "-wal").size();
+        copyPath = path;
+        return true;
+    }
+    return false;
+}
+}
+
+/**
+ * Copy of the database and its WAL, removed when the last connection to it is gone
+ */
+struct PlacesSnapshot {
+    QString path;
+    PlacesDatabase::SourceState state;
+
+    ~PlacesSnapshot()
+    {
+        removeFiles(path);
+    }
+};
+
+namespace
+{
+/**
+ * Latest snapshot of a source, the mutex makes concurrent opens wait for one copy instead of making several
+ */
+struct SnapshotSlot {
+    QMutex mutex;
+    std::shared_ptr<const PlacesSnapshot> snapshot;
+};
+
+QMutex s_slotsMutex;
+QHash<QString, std::shared_ptr<SnapshotSlot>> s_slots;
+
+std::shared_ptr<SnapshotSlot> snapshotSlot(const QString &sourcePath)
+{
+    QMutexLocker locker(&s_slotsMutex);
+    std::shared_ptr<SnapshotSlot> &slot = s_slots[sourcePath];
+    if (!slot) {
+        slot = std::make_shared<SnapshotSlot>();
+    }
+    return slot;
+}
+
+bool isProcessRunning(qint64 pid)
+{
+#ifdef Q_OS_LINUX
+    // EPERM: the process exists but belongs to another user
+    return pid > 0 && pid <= INT_MAX && (::kill(pid_t(pid), 0) == 0 || errno == EPERM);
+#else
+    Q_UNUSED(pid)
+    return true;
+#endif
+}
+
+/**
+ * Snapshots of processes that crashed or were killed, their files are never removed otherwise. Runs once per
+ * prefix, a process that reuses the PID of a dead one keeps its files until the next start.
+ */
+void removeStaleSnapshots(const QString &prefix)
+{
+    static QMutex mutex;
+    static QSet<QString> cleanedPrefixes;
+    {
+        QMutexLocker locker(&mutex);
+        if (cleanedPrefixes.contains(prefix)) {
+            return;
+        }
+        cleanedPrefixes.insert(prefix);
+    }
+
+    const QRegularExpression snapshotName(QLatin1Char('^') + QRegularExpression::escape(prefix) + QStringLiteral("(\\d+)_\\d+\\.sqlite(-wal|-shm)?$"));
+    const qint64 ownPid = QCoreApplication::applicationPid();
+    int removed = 0;
+    for (const QString &directory : PlacesDatabase::snapshotDirectories()) {
+        const QDir dir(directory);
+        for (const QString &fileName : dir.entryList({prefix + QLatin1Char('*')}, QDir::Files | QDir::Hidden)) {
+            const QRegularExpressionMatch match = snapshotName.match(fileName);
+            if (!match.hasMatch()) {
+                continue;
+            }
+            const qint64 pid = match.captured(1).toLongLong();
+            if (pid != ownPid && !isProcessRunning(pid) && QFile::remove(dir.filePath(fileName))) {
+                ++removed;
+            }
+        }
+    }
+    if (removed > 0) {
+        qCDebug(FIREFOX) << "Removed" << removed << "snapshot files of processes that are gone," << prefix;
+    }
+}
+
+std::shared_ptr<const PlacesSnapshot> makeSnapshot(const QString &sourcePath, const QString &prefix)
+{
+    removeStaleSnapshots(prefix);
+    for (int attempt = 1; attempt <= PlacesDatabase::MaxCopyAttempts; ++attempt) {
+        if (attempt > 1) {
+            // Zen writes in bursts, give the current one time to finish
+            QThread::msleep(10 * (attempt - 1));
+        }
+        const QDateTime started = QDateTime::currentDateTime();
+        const PlacesDatabase::SourceState before = PlacesDatabase::sourceState(sourcePath);
+        if (before.size < 0) {
+            qCDebug(FIREFOX) << "Database does not exist" << sourcePath;
+            return nullptr;
+        }
+        const QString fileName = QStringLiteral("%1%2_%3.sqlite").arg(prefix).arg(QCoreApplication::applicationPid()).arg(snapshotCounter++);
+        QString copyPath;
+        quint64 cloned = 0;
+        quint64 copied = 0;
+        if (!copyFiles(sourcePath, fileName, copyPath, cloned, copied)) {
+            qCDebug(FIREFOX) << "Failed to copy database, attempt" << attempt << sourcePath;
+            continue;
+        }
+        const PlacesDatabase::SourceState after = PlacesDatabase::sourceState(sourcePath);
+        const QDateTime racyLimit = started.addMSecs(-racyIntervalMs);
+        if (!(before == after) || after.modified >= racyLimit || (after.walSize >= 0 && after.walModified >= racyLimit)) {
+            qCDebug(FIREFOX) << "Database changed while copying, attempt" << attempt << sourcePath;
+            removeFiles(copyPath);
+            continue;
+        }
+
+        ++s_snapshots;
+        s_bytesCloned += cloned;
+        s_bytesCopied += copied;
+        s_lastBytesCopied = copied;
+        qCDebug(FIREFOX) << "Snapshot of" << sourcePath << "at" << copyPath << "cloned" << cloned << "bytes, copied" << copied << "bytes";
+        auto snapshot = std::make_shared<PlacesSnapshot>();
+        snapshot->path = copyPath;
+        snapshot->state = after;
+        return snapshot;
+    }
+    return nullptr;
+}
+}
+
+PlacesDatabase::PlacesDatabase(const QString &sourcePath, const QString &connectionPrefix)
+    : m_sourcePath(sourcePath)
+    , m_connectionPrefix(connectionPrefix)
+{
+    // Unique per object, concurrent match() calls must not share connections
+    const QString suffix = QString("%1_%2").arg(reinterpret_cast<qintptr>(QThread::currentThread())).arg(copyCounter++);
+    m_connectionName = connectionPrefix + suffix;
+}
+
+PlacesDatabase::~PlacesDatabase()
+{
+    if (m_db.isValid()) {
+        m_db.close();
+        m_db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
+    // Removes the files if the snapshot was replaced meanwhile and this was its last user
+    m_snapshot.reset();
+}
+
+bool PlacesDatabase::open()
+{
+    const std::shared_ptr<SnapshotSlot> slot = snapshotSlot(m_sourcePath);
+    {
+        QMutexLocker locker(&slot->mutex);
+        if (slot->snapshot && slot->snapshot->state == sourceState(m_sourcePath)) {
+            ++s_reuses;
+        } else {
+            // The files of the previous snapshot are removed once its connections are closed
+            slot->snapshot = makeSnapshot(m_sourcePath, m_connectionPrefix);
+        }
+        m_snapshot = slot->snapshot;
+    }
+    return openConnection();
+}
+
+bool PlacesDatabase::openSnapshotOf(const PlacesDatabase &other)
+{
+    m_snapshot = other.m_snapshot;
+    return openConnection();
+}
+
+bool PlacesDatabase::openConnection()
+{
+    if (!m_snapshot) {
+        return false;
+    }
+    m_db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    m_db.setDatabaseName(m_snapshot->path);
+    if (!m_db.open()) {
+        qCDebug(FIREFOX) << "Failed to open temp database:" << m_db.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void PlacesDatabase::releaseSnapshots()
+{
+    QMutexLocker locker(&s_slotsMutex);
+    for (const auto &slot : std::as_const(s_slots)) {
+        QMutexLocker slotLocker(&slot->mutex);
+        slot->snapshot.reset();
+    }
+    s_slots.clear();
+}
+
+PlacesDatabase::Stats PlacesDatabase::stats()
+{
+    Stats stats;
+    stats.snapshots = s_snapshots;
+    stats.reuses = s_reuses;
+    stats.bytesCloned = s_bytesCloned;
+    stats.bytesCopied = s_bytesCopied;
+    stats.lastBytesCopied = s_lastBytesCopied;
+    return stats;
+}
+
+QStringList PlacesDatabase::snapshotDirectories()
+{
+    QStringList directories;
+    // A clone has to be on the filesystem of the profile, the cache dir is usually on the one of the home dir
+    const QString cache = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (!cache.isEmpty()) {
+        directories.append(cache + QStringLiteral("/snapshots"));
+    }
+    return directories + copyDirectories();
+}
+
+PlacesDatabase::SourceState PlacesDatabase::sourceState(const QString &sourcePath)
+{
+    SourceState state;
+    const QFileInfo info(sourcePath);
+    if (info.exists()) {
+        state.size = info.size();
+        state.modified = info.lastModified();
+    }
+    const QFileInfo walInfo(sourcePath + "-wal");
+    if (walInfo.exists()) {
+        state.walSize = walInfo.size();
+        state.walModified = walInfo.lastModified();
+        QFile wal(walInfo.filePath());
+        if (wal.open(QIODevice::ReadOnly)) {
+            state.walHeader = wal.read(walHeaderSize);
+        }
+    }
+    return state;
+}
+
+QDateTime PlacesDatabase::sourceModified(const QString &sourcePath)
+{
+    const QDateTime dbModified = QFileInfo(sourcePath).lastModified();
+    const QFileInfo walInfo(sourcePath + "-wal");
+    if (walInfo.exists() && walInfo.lastModified() > dbModified) {
+        return walInfo.lastModified();
+    }
+    return dbModified;
+}
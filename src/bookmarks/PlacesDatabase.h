@@ -0,0 +1,104 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+
+struct PlacesSnapshot;
+
+/**
+ * Read access to a snapshot of a Zen database. Zen keeps places.sqlite and favicons.sqlite locked
+ * while it runs, so the database and its WAL file are copied and each object opens its own connection
+ * to the copy. The snapshot is shared and reused until the source changes, see releaseSnapshots().
+ * The copy is a copy-on-write clone next to the cache if the filesystem supports it, otherwise it goes to
+ * the runtime dir (usually a tmpfs) and only as last resort to the temp dir.
+ * Zen may write or checkpoint while the files are copied, which would give a torn pair of database and WAL.
+ * The copy is only used if the source did not change during copying, otherwise it is retried.
+ */
+class PlacesDatabase
+{
+public:
+    static constexpr int MaxCopyAttempts = 5;
+
+    struct Stats {
+        quint64 snapshots = 0; // Snapshots that were made
+        quint64 reuses = 0; // Opens that used an existing snapshot
+        quint64 bytesCloned = 0;
+        quint64 bytesCopied = 0;
+        quint64 lastBytesCopied = 0; // Of the most recent snapshot that had to be copied
+    };
+
+    /**
+     * What changes if Zen writes to the files: sizes, modification times and the WAL header, whose salts
+     * change when the WAL is restarted after a checkpoint
+     */
+    struct SourceState {
+        qint64 size = -1;
+        QDateTime modified;
+        qint64 walSize = -1;
+        QDateTime walModified;
+        QByteArray walHeader;
+
+        bool operator==(const SourceState &other) const
+        {
+            return size == other.size && modified == other.modified && walSize == other.walSize && walModified == other.walModified
+                && walHeader == other.walHeader;
+        }
+        bool operator!=(const SourceState &other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    PlacesDatabase(const QString &sourcePath, const QString &connectionPrefix);
+    ~PlacesDatabase();
+    Q_DISABLE_COPY(PlacesDatabase)
+
+    /**
+     * Open the snapshot, fails if no consistent copy could be made in MaxCopyAttempts
+     */
+    bool open();
+    /**
+     * Open another connection to the snapshot that is open in other, e.g. to read tables on several threads.
+     * The connection belongs to the calling thread like every QSqlDatabase.
+     */
+    bool openSnapshotOf(const PlacesDatabase &other);
+    QSqlDatabase database() const
+    {
+        return m_db;
+    }
+    QString sourcePath() const
+    {
+        return m_sourcePath;
+    }
+
+    /**
+     * Last modification of the database including the WAL file, which receives the writes while Zen runs
+     */
+    static QDateTime sourceModified(const QString &sourcePath);
+    static SourceState sourceState(const QString &sourcePath);
+
+    /**
+     * Remove the snapshots that are not in use, the others are removed once their connections are closed
+     */
+    static void releaseSnapshots();
+    static Stats stats();
+    /**
+     * Where snapshots are made, in the order they are tried. The first snapshot with a prefix removes the
+     * ones with that prefix that processes which are no longer running left behind.
+     */
+    static QStringList snapshotDirectories();
+
+private:
+    bool openConnection();
+
+    QString m_sourcePath;
+    QString m_connectionPrefix;
+    QString m_connectionName;
+    std::shared_ptr<const PlacesSnapshot> m_snapshot;
+    QSqlDatabase m_db;
+};
@@ -0,0 +1,413 @@
+#include "PlacesReader.h"
+
+#include "ParallelFor.h"
+#include "PlacesDatabase.h"
+#include "firefox_debug.h"
+#include <QElapsedTimer>
+#include <QSet>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+// Tags are folders below the tags root, tagging a URL adds an untitled bookmark for it to the tag folder
+static const QString tagFolders = QStringLiteral("SELECT id FROM moz_bookmarks WHERE parent = (SELECT id FROM moz_bookmarks WHERE guid = 'tags________')");
+static const QString selectBookmarks = QStringLiteral(
+    "SELECT b.id, b.guid, b.title, p.url, b.lastModified, p.last_visit_date, p.frecency, p.id, f.title, "
+    "(SELECT GROUP_CONCAT(t.title, ',') FROM moz_bookmarks tb JOIN moz_bookmarks t ON t.id = tb.parent "
+    "WHERE tb.fk = b.fk AND tb.parent IN (%1)), b.parent, b.position "
+    "FROM moz_bookmarks b JOIN moz_places p ON b.fk = p.id LEFT JOIN moz_bookmarks f ON f.id = b.parent ")
+                                         .arg(tagFolders);
+// Renamed folders and tag changes do not touch the lastModified of the bookmarks themselves
+static const QString changedSince = QStringLiteral(
+    "(b.lastModified > ? OR f.lastModified > ? OR b.fk IN (SELECT tb.fk FROM moz_bookmarks tb JOIN moz_bookmarks t ON t.id = tb.parent "
+    "WHERE tb.parent IN (%1) AND (tb.lastModified > ? OR t.lastModified > ?)))")
+                                        .arg(tagFolders);
+static const QString hasTitle = QStringLiteral("b.title IS NOT NULL AND b.title != ''");
+
+namespace
+{
+// Tables of a parallel full load, each is read on its own connection
+enum Table {
+    Bookmarks,
+    Places,
+    Folders,
+    Tags,
+    TableCount,
+};
+
+struct BookmarkRow {
+    qint64 id;
+    qint64 placeId;
+    qint64 folderId;
+    int position;
+    qint64 lastModified;
+    QString guid;
+    QString title;
+};
+
+struct PlaceRow {
+    QString url;
+    qint64 lastVisitDate;
+    int frecency;
+};
+}
+
+static const QString tableQueries[TableCount] = {
+    QStringLiteral("SELECT b.id, b.fk, b.parent, b.position, b.lastModified, b.guid, b.title FROM moz_bookmarks b WHERE b.fk IS NOT NULL AND ") + hasTitle,
+    QStringLiteral("SELECT p.id, p.url, p.last_visit_date, p.frecency FROM moz_places p WHERE p.id IN (SELECT fk FROM moz_bookmarks)"),
+    QStringLiteral("SELECT f.id, f.title FROM moz_bookmarks f WHERE f.id IN (SELECT parent FROM moz_bookmarks)"),
+    QStringLiteral("SELECT tb.fk, t.title FROM moz_bookmarks tb JOIN moz_bookmarks t ON t.id = tb.parent WHERE tb.parent IN (%1)").arg(tagFolders),
+};
+// Preparing a bookmark takes a few microseconds, mostly URL parsing
+static constexpr std::size_t PrepareChunkSize = 1024;
+
+static Bookmark bookmarkFromQuery(const QSqlQuery &query)
+{
+    Bookmark bookmark;
+    bookmark.id = query.value(0).toLongLong();
+    bookmark.guid = query.value(1).toString();
+    bookmark.title = query.value(2).toString();
+    bookmark.url = query.value(3).toString();
+    bookmark.lastModified = query.value(4).toLongLong();
+    bookmark.lastVisitDate = query.value(5).toLongLong();
+    bookmark.frecency = query.value(6).toInt();
+    bookmark.placeId = query.value(7).toLongLong();
+    bookmark.folder = query.value(8).toString();
+    // Tags can not contain commas
+    bookmark.tags = query.value(9).toString().split(QLatin1Char(','), Qt::SkipEmptyParts);
+    bookmark.folderId = query.value(10).toLongLong();
+    bookmark.position = query.value(11).toInt();
+    return bookmark;
+}
+
+/**
+ * Full load of all bookmarks, this replaces the content of the index
+ */
+bool PlacesReader::readAll(BookmarkIndex &index)
+{
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    if (!query.exec(selectBookmarks + "WHERE " + hasTitle)) {
+        qCDebug(FIREFOX) << "Failed to execute bookmark query:" << query.lastError().text();
+        return false;
+    }
+    BookmarkIndex fresh;
+    while (query.next()) {
+        const Bookmark bookmark = bookmarkFromQuery(query);
+        if (!bookmark.url.isEmpty()) {
+            fresh.upsert(bookmark);
+        }
+    }
+
+    completeLoad(fresh);
+    index = std::move(fresh);
+    qCDebug(FIREFOX) << "Loaded" << index.size() << "bookmarks";
+    return true;
+}
+
+bool PlacesReader::readAllParallel(const PlacesDatabase &places, BookmarkIndex &index, BuildStats *stats)
+{
+    QElapsedTimer timer;
+    timer.start();
+    BuildStats build;
+
+    // Every table has its own connection, a QSqlDatabase can only be used on the thread that opened it
+    QVector<BookmarkRow> rows;
+    QHash<qint64, PlaceRow> placeRows;
+    QHash<qint64, QString> folderTitles;
+    QHash<qint64, QStringList> tags;
+    std::atomic<bool> failed{false};
+    ParallelFor::run(TableCount, [&](int table) {
+        PlacesDatabase connection(places.sourcePath(), QStringLiteral("zen_bookmarks_build_"));
+        if (!connection.openSnapshotOf(places)) {
+            failed = true;
+            return;
+        }
+        QSqlQuery query(connection.database());
+        query.setForwardOnly(true);
+        if (!query.exec(tableQueries[table])) {
+            qCDebug(FIREFOX) << "Failed to read bookmark table:" << query.lastError().text();
+            failed = true;
+            return;
+        }
+        switch (table) {
+        case Bookmarks:
+            while (query.next()) {
+                rows.append(BookmarkRow{query.value(0).toLongLong(),
+                                        query.value(1).toLongLong(),
+                                        query.value(2).toLongLong(),
+                                        query.value(3).toInt(),
+                                        query.value(4).toLongLong(),
+                                        query.value(5).toString(),
+                                        query.value(6).toString()});
+            }
+            break;
+        case Places:
+            while (query.next()) {
+                placeRows.insert(query.value(0).toLongLong(), PlaceRow{query.value(1).toString(), query.value(2).toLongLong(), query.value(3).toInt()});
+            }
+            break;
+        case Folders:
+            while (query.next()) {
+                folderTitles.insert(query.value(0).toLongLong(), query.value(1).toString());
+            }
+            break;
+        case Tags:
+            while (query.next()) {
+                if (const QString tag = query.value(1).toString(); !tag.isEmpty()) {
+                    tags[query.value(0).toLongLong()].append(tag);
+                }
+            }
+            break;
+        }
+    });
+    if (failed) {
+        return false;
+    }
+    build.readUs = timer.nsecsElapsed() / 1000;
+
+    std::vector<Bookmark> bookmarks;
+    bookmarks.reserve(rows.size());
+    for (const BookmarkRow &row : std::as_const(rows)) {
+        const auto place = placeRows.constFind(row.placeId);
+        if (place == placeRows.constEnd() || place->url.isEmpty()) {
+            continue;
+        }
+        Bookmark bookmark;
+        bookmark.id = row.id;
+        bookmark.guid = row.guid;
+        bookmark.title = row.title;
+        bookmark.url = place->url;
+        bookmark.lastModified = row.lastModified;
+        bookmark.lastVisitDate = place->lastVisitDate;
+        bookmark.frecency = place->frecency;
+        bookmark.placeId = row.placeId;
+        bookmark.folder = folderTitles.value(row.folderId);
+        bookmark.folderId = row.folderId;
+        bookmark.position = row.position;
+        bookmark.tags = tags.value(row.placeId);
+        bookmarks.push_back(std::move(bookmark));
+    }
+    std::vector<QVector<UrlTerm>> urlTerms(bookmarks.size());
+    const int chunks = int((bookmarks.size() + PrepareChunkSize - 1) / PrepareChunkSize);
+    ParallelFor::run(chunks, [&](int chunk) {
+        const std::size_t end = std::min(bookmarks.size(), std::size_t(chunk + 1) * PrepareChunkSize);
+        for (std::size_t i = std::size_t(chunk) * PrepareChunkSize; i < end; ++i) {
+            urlTerms[i] = BookmarkIndex::prepare(bookmarks[i]);
+        }
+    });
+    build.prepareUs = timer.nsecsElapsed() / 1000 - build.readUs;
+
+    BookmarkIndex fresh;
+    fresh.reserve(int(bookmarks.size()));
+    for (std::size_t i = 0; i < bookmarks.size(); ++i) {
+        fresh.upsert(std::move(bookmarks[i]), urlTerms[i]);
+    }
+    PlacesReader(places.database()).completeLoad(fresh);
+    index = std::move(fresh);
+    build.totalUs = timer.nsecsElapsed() / 1000;
+    build.insertUs = build.totalUs - build.readUs - build.prepareUs;
+    qCDebug(FIREFOX) << "Loaded" << index.size() << "bookmarks in" << build.totalUs << "us, reading" << build.readUs << "us, preparing"
+                     << build.prepareUs << "us, inserting" << build.insertUs << "us";
+    if (stats) {
+        *stats = build;
+    }
+    return true;
+}
+
+/**
+ * Watermarks and keywords of a full load, read after the bookmarks
+ */
+void PlacesReader::completeLoad(BookmarkIndex &fresh)
+{
+    fresh.buildWordStarts();
+    fresh.modifiedWatermark = std::max(fresh.modifiedWatermark, maxLastModified());
+
+    // The bookmarks are still usable if the keywords can not be read
+    bool keywordsOk = true;
+    fresh.setKeywords(readKeywords(keywordsOk));
+
+    // Tombstones that exist now are already reflected in the loaded rows
+    if (m_db.tables().contains(QStringLiteral("moz_bookmarks_deleted"))) {
+        QSqlQuery removedQuery(m_db);
+        if (removedQuery.exec(QStringLiteral("SELECT MAX(dateRemoved) FROM moz_bookmarks_deleted")) && removedQuery.next()) {
+            fresh.removedWatermark = removedQuery.value(0).toLongLong();
+        }
+    }
+}
+
+/**
+ * Apply the changes since the last sync to the index. Added and modified bookmarks are found using the
+ * lastModified (of the bookmark, its folder and its tags) and last_visit_date watermarks, removals using
+ * the tombstones and a count check.
+ * Only if the index can not be reconciled with the database it is rebuilt from scratch.
+ */
+PlacesReader::SyncResult PlacesReader::sync(BookmarkIndex &index)
+{
+    if (index.modifiedWatermark == 0) {
+        return readAll(index) ? SyncResult::Rebuilt : SyncResult::Failed;
+    }
+
+    // Capture both watermarks first, applying the first query advances them
+    const qint64 modifiedWatermark = index.modifiedWatermark;
+    const qint64 visitWatermark = index.visitWatermark;
+    bool ok = true;
+    int changes = applyTombstones(index, ok);
+    changes += readChanges(index, changedSince, modifiedWatermark, ok);
+    changes += readChanges(index, QStringLiteral("p.last_visit_date > ?"), visitWatermark, ok);
+
+    const QHash<QString, BookmarkKeyword> keywords = readKeywords(ok);
+    if (ok && keywords != index.keywords()) {
+        index.setKeywords(keywords);
+        ++changes;
+    }
+
+    int count = countBookmarks(ok);
+    if (ok && count < index.size()) {
+        // Bookmarks that are not synced do not get a tombstone, find them using the ids
+        changes += removeMissing(index, ok);
+        count = countBookmarks(ok);
+    }
+    if (!ok || count != index.size()) {
+        qCDebug(FIREFOX) << "Can not apply bookmark changes, rebuilding index" << count << index.size();
+        return readAll(index) ? SyncResult::Rebuilt : SyncResult::Failed;
+    }
+    // Includes folders and tags, their changes are applied now as well
+    index.modifiedWatermark = std::max(index.modifiedWatermark, maxLastModified());
+    if (index.wordStarts().isEmpty()) {
+        index.buildWordStarts();
+    }
+    qCDebug(FIREFOX) << "Applied" << changes << "bookmark changes";
+    return changes == 0 ? SyncResult::Unchanged : SyncResult::Patched;
+}
+
+int PlacesReader::readChanges(BookmarkIndex &index, const QString &condition, qint64 watermark, bool &ok)
+{
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare(selectBookmarks + "WHERE " + condition);
+    for (int i = condition.count(QLatin1Char('?')); i > 0; --i) {
+        query.addBindValue(watermark);
+    }
+    if (!query.exec()) {
+        qCDebug(FIREFOX) << "Failed to query bookmark changes:" << query.lastError().text();
+        ok = false;
+        return 0;
+    }
+    int changes = 0;
+    while (query.next()) {
+        const Bookmark bookmark = bookmarkFromQuery(query);
+        if (bookmark.title.isEmpty() || bookmark.url.isEmpty()) {
+            // The title was removed, such bookmarks are not searchable
+            changes += index.remove(bookmark.id) ? 1 : 0;
+            index.modifiedWatermark = std::max(index.modifiedWatermark, bookmark.lastModified);
+            continue;
+        }
+        index.upsert(bookmark);
+        ++changes;
+    }
+    return changes;
+}
+
+/**
+ * Keyword shortcuts, the table is small so it is read completely on every sync.
+ * Keywords with post_data are skipped, they need a POST request that can not be passed to the browser.
+ */
+QHash<QString, BookmarkKeyword> PlacesReader::readKeywords(bool &ok)
+{
+    QHash<QString, BookmarkKeyword> keywords;
+    if (!m_db.tables().contains(QStringLiteral("moz_keywords"))) {
+        return keywords;
+    }
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    if (!query.exec(QStringLiteral("SELECT k.keyword, p.url, "
+                                   "(SELECT b.title FROM moz_bookmarks b WHERE b.fk = p.id AND b.title != '' LIMIT 1) "
+                                   "FROM moz_keywords k JOIN moz_places p ON k.place_id = p.id "
+                                   "WHERE k.post_data IS NULL OR k.post_data = ''"))) {
+        qCDebug(FIREFOX) << "Failed to query bookmark keywords:" << query.lastError().text();
+        ok = false;
+        return keywords;
+    }
+    while (query.next()) {
+        BookmarkKeyword keyword;
+        keyword.keyword = query.value(0).toString().toLower();
+        keyword.url = query.value(1).toString();
+        keyword.title = query.value(2).toString();
+        if (!keyword.keyword.isEmpty() && !keyword.url.isEmpty()) {
+            keywords.insert(keyword.keyword, keyword);
+        }
+    }
+    return keywords;
+}
+
+int PlacesReader::applyTombstones(BookmarkIndex &index, bool &ok)
+{
+    if (!m_db.tables().contains(QStringLiteral("moz_bookmarks_deleted"))) {
+        return 0;
+    }
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare(QStringLiteral("SELECT guid, dateRemoved FROM moz_bookmarks_deleted WHERE dateRemoved > ?"));
+    query.addBindValue(index.removedWatermark);
+    if (!query.exec()) {
+        ok = false;
+        return 0;
+    }
+    int changes = 0;
+    while (query.next()) {
+        if (const qint64 id = index.idForGuid(query.value(0).toString())) {
+            changes += index.remove(id) ? 1 : 0;
+        }
+        index.removedWatermark = std::max(index.removedWatermark, query.value(1).toLongLong());
+    }
+    return changes;
+}
+
+int PlacesReader::removeMissing(BookmarkIndex &index, bool &ok)
+{
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT b.id FROM moz_bookmarks b JOIN moz_places p ON b.fk = p.id WHERE " + hasTitle)) {
+        ok = false;
+        return 0;
+    }
+    QSet<qint64> existing;
+    existing.reserve(index.size());
+    while (query.next()) {
+        existing.insert(query.value(0).toLongLong());
+    }
+    QVector<qint64> missing;
+    for (const Bookmark &bookmark : index.bookmarks()) {
+        if (!existing.contains(bookmark.id)) {
+            missing.append(bookmark.id);
+        }
+    }
+    for (const qint64 id : std::as_const(missing)) {
+        index.remove(id);
+    }
+    return missing.size();
+}
+
+int PlacesReader::countBookmarks(bool &ok)
+{
+    QSqlQuery query(m_db);
+    if (!query.exec("SELECT COUNT(*) FROM moz_bookmarks b JOIN moz_places p ON b.fk = p.id WHERE " + hasTitle) || !query.next()) {
+        ok = false;
+        return -1;
+    }
+    return query.value(0).toInt();
+}
+
+qint64 PlacesReader::maxLastModified()
+{
+    QSqlQuery query(m_db);
+    if (!query.exec(QStringLiteral("SELECT MAX(lastModified) FROM moz_bookmarks")) || !query.next()) {
+        return 0;
+    }
+    return query.value(0).toLongLong();
+}
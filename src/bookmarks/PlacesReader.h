@@ -0,0 +1,54 @@
+#pragma once
+
+#include "BookmarkIndex.h"
+
+#include <QSqlDatabase>
+
+class PlacesDatabase;
+
+/**
+ * Loads bookmarks from places.sqlite into a BookmarkIndex
+ */
+class PlacesReader
+{
+public:
+    enum class SyncResult {
+        Failed,
+        Unchanged,
+        Patched,
+        Rebuilt,
+    };
+
+    struct BuildStats {
+        qint64 readUs = 0; // Reading the tables
+        qint64 prepareUs = 0; // Deriving the search fields of the bookmarks
+        qint64 insertUs = 0; // Building the lookups, postings and word start lists
+        qint64 totalUs = 0;
+    };
+
+    explicit PlacesReader(const QSqlDatabase &db)
+        : m_db(db)
+    {
+    }
+
+    bool readAll(BookmarkIndex &index);
+    SyncResult sync(BookmarkIndex &index);
+
+    /**
+     * Full load like readAll(). Bookmarks, places, folders and tags are read over separate connections to the
+     * snapshot of places on parallel threads and joined by place id, the search fields of the bookmarks are
+     * derived in parallel as well. Only inserting them into the index is serial.
+     */
+    static bool readAllParallel(const PlacesDatabase &places, BookmarkIndex &index, BuildStats *stats = nullptr);
+
+private:
+    void completeLoad(BookmarkIndex &fresh);
+    int readChanges(BookmarkIndex &index, const QString &condition, qint64 watermark, bool &ok);
+    QHash<QString, BookmarkKeyword> readKeywords(bool &ok);
+    int applyTombstones(BookmarkIndex &index, bool &ok);
+    int removeMissing(BookmarkIndex &index, bool &ok);
+    int countBookmarks(bool &ok);
+    qint64 maxLastModified();
+
+    QSqlDatabase m_db;
+};
@@ -0,0 +1,77 @@
+#include "QueryArena.h"
+
+#include <algorithm>
+#include <atomic>
+
+static std::atomic<quint64> s_highWater{0};
+static std::atomic<quint64> s_capacity{0};
+static std::atomic<quint64> s_overflows{0};
+static std::atomic<quint64> s_resets{0};
+
+static void updateMaximum(std::atomic<quint64> &maximum, quint64 value)
+{
+    quint64 current = maximum.load(std::memory_order_relaxed);
+    while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)) { }
+}
+
+QueryArena::Scope::Scope()
+{
+    ++local().m_depth;
+}
+
+QueryArena::Scope::~Scope()
+{
+    QueryArena &arena = local();
+    if (--arena.m_depth == 0) {
+        arena.reset();
+    }
+}
+
+QueryArena &QueryArena::local()
+{
+    static thread_local QueryArena arena;
+    return arena;
+}
+
+QueryArena::QueryArena()
+    : m_buffer(new std::byte[InitialCapacity])
+    , m_capacity(InitialCapacity)
+{
+    m_monotonic.emplace(m_buffer.get(), m_capacity, std::pmr::new_delete_resource());
+    m_tracking.upstream = &*m_monotonic;
+    updateMaximum(s_capacity, m_capacity);
+}
+
+void QueryArena::reset()
+{
+    const std::size_t used = m_tracking.used;
+    updateMaximum(s_highWater, used);
+    s_resets.fetch_add(1, std::memory_order_relaxed);
+
+    // Destroying the monotonic resource returns the overflow chunks to the heap
+    m_tracking.upstream = nullptr;
+    m_monotonic.reset();
+    if (used > m_capacity) {
+        s_overflows.fetch_add(1, std::memory_order_relaxed);
+        // Room for alignment padding and a slightly larger query next time
+        const std::size_t capacity = std::min(MaximumCapacity, std::max(m_capacity * 2, used + used / 2));
+        if (capacity > m_capacity) {
+            m_buffer.reset(new std::byte[capacity]);
+            m_capacity = capacity;
+            updateMaximum(s_capacity, m_capacity);
+        }
+    }
+    m_monotonic.emplace(m_buffer.get(), m_capacity, std::pmr::new_delete_resource());
+    m_tracking.upstream = &*m_monotonic;
+    m_tracking.used = 0;
+}
+
+QueryArena::Stats QueryArena::stats()
+{
+    Stats stats;
+    stats.highWaterBytes = s_highWater.load(std::memory_order_relaxed);
+    stats.capacityBytes = s_capacity.load(std::memory_order_relaxed);
+    stats.overflows = s_overflows.load(std::memory_order_relaxed);
+    stats.resets = s_resets.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+/**
+ * Per thread arena for the scratch buffers of a query: candidate lists, scores and case folded terms.
+ * Allocations are bump allocations from a buffer that is reset when the outermost Scope of the thread ends.
+ * If a query needs more than the buffer the overflow comes from the heap and the buffer is grown to the
+ * high-water mark on reset, so queries of a steady size do not reach the general purpose allocator.
+ */
+class QueryArena
+{
+public:
+    static constexpr std::size_t InitialCapacity = 64 * 1024;
+    // Larger buffers are not kept between queries
+    static constexpr std::size_t MaximumCapacity = 8 * 1024 * 1024;
+
+    struct Stats {
+        quint64 highWaterBytes = 0; // Largest amount a single query used
+        quint64 capacityBytes = 0; // Largest buffer of a thread
+        quint64 overflows = 0; // Queries that exceeded the buffer of their thread
+        quint64 resets = 0;
+    };
+
+    /**
+     * Marks a query, the arena of the thread is reset when the outermost scope ends
+     */
+    class Scope
+    {
+    public:
+        Scope();
+        ~Scope();
+        Q_DISABLE_COPY(Scope)
+    };
+
+    static QueryArena &local();
+    static std::pmr::memory_resource *resource()
+    {
+        return &local().m_tracking;
+    }
+    static Stats stats();
+
+    std::size_t used() const
+    {
+        return m_tracking.used;
+    }
+    std::size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+private:
+    QueryArena();
+    void reset();
+
+    // Counts the requested bytes, the monotonic resource does not expose them
+    class TrackingResource : public std::pmr::memory_resource
+    {
+    public:
+        std::pmr::memory_resource *upstream = nullptr;
+        std::size_t used = 0;
+
+    private:
+        void *do_allocate(std::size_t bytes, std::size_t alignment) override
+        {
+            used += bytes;
+            return upstream->allocate(bytes, alignment);
+        }
+        void do_deallocate(void *ptr, std::size_t bytes, std::size_t alignment) override
+        {
+            upstream->deallocate(ptr, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+
+    std::unique_ptr<std::byte[]> m_buffer;
+    std::size_t m_capacity = 0;
+    std::optional<std::pmr::monotonic_buffer_resource> m_monotonic;
+    TrackingResource m_tracking;
+    int m_depth = 0;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+/**
+ * Publishes immutable generations of T to concurrent readers (RCU-style).
+ *
+ * Readers take a reference on the current generation without locking: they announce themselves in the
+ * reader counter of the current epoch, copy the shared_ptr and leave the epoch again. A writer swaps in the
+ * next generation, advances the epoch and waits until no reader of the previous epoch can still be copying
+ * the old pointer. A generation is freed when the last reader holding it drops its reference.
+ *
+ * Writers must be serialized by the caller, readers never block.
+ */
+template<typename T>
+class SnapshotPublisher
+{
+public:
+    using Ptr = std::shared_ptr<const T>;
+
+    SnapshotPublisher()
+        : m_current(new Ptr())
+    {
+    }
+    ~SnapshotPublisher()
+    {
+        delete m_current.load();
+    }
+    SnapshotPublisher(const SnapshotPublisher &) = delete;
+    SnapshotPublisher &operator=(const SnapshotPublisher &) = delete;
+
+    Ptr acquire() const
+    {
+        for (;;) {
+            const unsigned epoch = m_epoch.load();
+            std::atomic<int> &readers = m_readers[epoch & 1];
+            ++readers;
+            if (m_epoch.load() != epoch) {
+                // The writer advanced the epoch in between and may already wait for the other counter
+                --readers;
+                continue;
+            }
+            Ptr snapshot = *m_current.load();
+            --readers;
+            return snapshot;
+        }
+    }
+
+    void publish(Ptr next)
+    {
+        Ptr *previous = m_current.exchange(new Ptr(std::move(next)));
+        const unsigned epoch = m_epoch.fetch_add(1);
+        // Readers that entered the previous epoch might still copy from the old slot
+        while (m_readers[epoch & 1].load() != 0) {
+            std::this_thread::yield();
+        }
+        delete previous;
+    }
+
+private:
+    std::atomic<Ptr *> m_current;
+    mutable std::atomic<unsigned> m_epoch{0};
+    mutable std::atomic<int> m_readers[2] = {{0}, {0}};
+};
@@ -0,0 +1,180 @@
+#include "SubstringSearch.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SUBSTRING_SEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+ * Texts with fewer candidate positions than a vector has lanes, and the whole text for the scalar variant
+ */
+static bool containsSequential(const char16_t *text, std::size_t textLength, const char16_t *needle, std::size_t needleLength)
+{
+    const char16_t first = needle[0];
+    for (std::size_t i = 0; i + needleLength <= textLength; ++i) {
+        if (text[i] == first && std::memcmp(text + i + 1, needle + 1, (needleLength - 1) * sizeof(char16_t)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SubstringSearch::containsScalar(const char16_t *text, std::size_t textLength, const char16_t *needle, std::size_t needleLength)
+{
+    if (needleLength == 0) {
+        return true;
+    }
+    return containsSequential(text, textLength, needle, needleLength);
+}
+
+#ifdef SUBSTRING_SEARCH_X86
+// SSE2 is part of x86-64, for 32 bit builds it is checked at runtime like AVX2
+__attribute__((target("sse2"))) bool SubstringSearch::containsSse2(const char16_t *text, std::size_t textLength, const char16_t *needle, std::size_t needleLength)
+{
+    if (needleLength == 0) {
+        return true;
+    }
+    if (needleLength > textLength) {
+        return false;
+    }
+    const std::size_t lastOffset = needleLength - 1;
+    const __m128i first = _mm_set1_epi16(static_cast<short>(needle[0]));
+    const __m128i last = _mm_set1_epi16(static_cast<short>(needle[lastOffset]));
+    // Number of positions the needle can start at, the last vector overlaps the previous one instead of
+    // falling back to the scalar loop for the remainder
+    const std::size_t positions = textLength - lastOffset;
+    if (positions < 8) {
+        return containsSequential(text, textLength, needle, needleLength);
+    }
+    for (std::size_t i = 0;; i += 8) {
+        i = std::min(i, positions - 8);
+        const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        const __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i + lastOffset));
+        const __m128i matches = _mm_and_si128(_mm_cmpeq_epi16(first, blockFirst), _mm_cmpeq_epi16(last, blockLast));
+        // Two mask bits per character
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(matches));
+        while (mask != 0) {
+            const unsigned bit = __builtin_ctz(mask);
+            if (std::memcmp(text + i + bit / 2 + 1, needle + 1, (needleLength - 1) * sizeof(char16_t)) == 0) {
+                return true;
+            }
+            mask &= ~(3u << bit);
+        }
+        if (i + 8 == positions) {
+            return false;
+        }
+    }
+}
+
+__attribute__((target("avx2"))) bool SubstringSearch::containsAvx2(const char16_t *text, std::size_t textLength, const char16_t *needle, std::size_t needleLength)
+{
+    if (needleLength == 0) {
+        return true;
+    }
+    if (needleLength > textLength) {
+        return false;
+    }
+    const std::size_t lastOffset = needleLength - 1;
+    const __m256i first = _mm256_set1_epi16(static_cast<short>(needle[0]));
+    const __m256i last = _mm256_set1_epi16(static_cast<short>(needle[lastOffset]));
+    const std::size_t positions = textLength - lastOffset;
+    if (positions < 16) {
+        return containsSse2(text, textLength, needle, needleLength);
+    }
+    for (std::size_t i = 0;; i += 16) {
+        i = std::min(i, positions - 16);
+        const __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+        const __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i + lastOffset));
+        const __m256i matches = _mm256_and_si256(_mm256_cmpeq_epi16(first, blockFirst), _mm256_cmpeq_epi16(last, blockLast));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(matches));
+        while (mask != 0) {
+            const unsigned bit = __builtin_ctz(mask);
+            if (std::memcmp(text + i + bit / 2 + 1, needle + 1, (needleLength - 1) * sizeof(char16_t)) == 0) {
+                return true;
+            }
+            mask &= ~(3u << bit);
+        }
+        if (i + 16 == positions) {
+            return false;
+        }
+    }
+}
+#else
+bool SubstringSearch::containsSse2(const char16_t *text, std::size_t textLength, const char16_t *needle, std::size_t needleLength)
+{
+    return containsScalar(text, textLength, needle, needleLength);
+}
+
+bool SubstringSearch::containsAvx2(const char16_t *text, std::size_t textLength, const char16_t *needle, std::size_t needleLength)
+{
+    return containsScalar(text, textLength, needle, needleLength);
+}
+#endif
+
+bool SubstringSearch::isSupported(Implementation implementation)
+{
+    switch (implementation) {
+    case Implementation::Scalar:
+        return true;
+#ifdef SUBSTRING_SEARCH_X86
+    case Implementation::Sse2:
+        return __builtin_cpu_supports("sse2");
+    case Implementation::Avx2:
+        return __builtin_cpu_supports("avx2");
+#else
+    case Implementation::Sse2:
+    case Implementation::Avx2:
+        break;
+#endif
+    }
+    return false;
+}
+
+SubstringSearch::Implementation SubstringSearch::implementation()
+{
+    static const Implementation selected = isSupported(Implementation::Avx2) ? Implementation::Avx2
+        : isSupported(Implementation::Sse2)                                  ? Implementation::Sse2
+                                                                             : Implementation::Scalar;
+    return selected;
+}
+
+const char *SubstringSearch::implementationName(Implementation implementation)
+{
+    switch (implementation) {
+    case Implementation::Scalar:
+        break;
+    case Implementation::Sse2:
+        return "SSE2";
+    case Implementation::Avx2:
+        return "AVX2";
+    }
+    return "scalar";
+}
+
+bool SubstringSearch::contains(Implementation implementation, const char16_t *text, std::size_t textLength, const char16_t *needle, std::size_t needleLength)
+{
+    switch (implementation) {
+    case Implementation::Scalar:
+        break;
+    case Implementation::Sse2:
+        return containsSse2(text, textLength, needle, needleLength);
+    case Implementation::Avx2:
+        return containsAvx2(text, textLength, needle, needleLength);
+    }
+    return containsScalar(text, textLength, needle, needleLength);
+}
+
+const SubstringSearch::Function SubstringSearch::s_contains = []() -> Function {
+    switch (implementation()) {
+    case Implementation::Scalar:
+        break;
+    case Implementation::Sse2:
+        return &containsSse2;
+    case Implementation::Avx2:
+        return &containsAvx2;
+    }
+    return &containsScalar;
+}();
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Substring search over UTF-16 text. Both sides are expected to be case folded already, the index keeps folded
+ * titles so that the case-insensitive comparison costs nothing per row.
+ *
+ * The vectorized variants compare the first and the last character of the needle against 8 (SSE2) or
+ * 16 (AVX2) positions of the text at once and only verify the positions where both match. The implementation
+ * is selected once at runtime from the CPU features, other architectures use the scalar loop.
+ */
+class SubstringSearch
+{
+public:
+    enum class Implementation {
+        Scalar,
+        Sse2,
+        Avx2,
+    };
+
+    static bool contains(const char16_t *text, std::size_t textLength, const char16_t *needle, std::size_t needleLength)
+    {
+        return s_contains(text, textLength, needle, needleLength);
+    }
+
+    static Implementation implementation();
+    static const char *implementationName(Implementation implementation);
+    /**
+     * False if the CPU does not support it, the benchmark and the tests only run the available ones
+     */
+    static bool isSupported(Implementation implementation);
+    static bool contains(Implementation implementation, const char16_t *text, std::size_t textLength, const char16_t *needle, std::size_t needleLength);
+
+    static bool containsScalar(const char16_t *text, std::size_t textLength, const char16_t *needle, std::size_t needleLength);
+    static bool containsSse2(const char16_t *text, std::size_t textLength, const char16_t *needle, std::size_t needleLength);
+    static bool containsAvx2(const char16_t *text, std::size_t textLength, const char16_t *needle, std::size_t needleLength);
+
+private:
+    using Function = bool (*)(const char16_t *, std::size_t, const char16_t *, std::size_t);
+    static const Function s_contains;
+};
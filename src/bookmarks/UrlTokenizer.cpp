@@ -0,0 +1,122 @@
+#include "UrlTokenizer.h"
+
+#include <QRegularExpression>
+#include <QUrl>
+#include <QUrlQuery>
+
+QVector<UrlTerm> UrlTokenizer::tokenize(const QString &url)
+{
+    QVector<UrlTerm> terms;
+    const auto add = [&terms](const QString &text, UrlField field) {
+        // A word is indexed once with the most relevant field it appears in
+        for (UrlTerm &term : terms) {
+            if (term.text == text) {
+                if (weight(field) > weight(term.field)) {
+                    term.field = field;
+                }
+                return;
+            }
+        }
+        terms.append(UrlTerm{text, field});
+    };
+
+    const QUrl parsed(url);
+    if (!parsed.scheme().isEmpty()) {
+        add(parsed.scheme().toLower(), UrlField::Scheme);
+    }
+
+    const QStringList labels = parsed.host().toLower().split(QLatin1Char('.'), Qt::SkipEmptyParts);
+    const int suffixLabels = publicSuffixLabels(labels);
+    for (int i = 0; i < labels.size(); ++i) {
+        UrlField field = UrlField::Subdomain;
+        if (i >= labels.size() - suffixLabels) {
+            field = UrlField::Suffix;
+        } else if (i == labels.size() - suffixLabels - 1) {
+            field = UrlField::Domain;
+        } else if (labels.at(i) == QLatin1String("www")) {
+            continue;
+        }
+        for (const QString &word : words(labels.at(i))) {
+            add(word, field);
+        }
+    }
+
+    for (const QString &word : words(parsed.path(QUrl::FullyDecoded))) {
+        add(word, UrlField::Path);
+    }
+
+    const auto queryItems = QUrlQuery(parsed).queryItems();
+    for (const auto &item : queryItems) {
+        if (!isTrackingParameter(item.first)) {
+            for (const QString &word : words(item.first)) {
+                add(word, UrlField::QueryKey);
+            }
+        }
+    }
+    return terms;
+}
+
+float UrlTokenizer::weight(UrlField field)
+{
+    switch (field) {
+    case UrlField::Domain:
+    case UrlField::Subdomain:
+        return 0.85;
+    case UrlField::Path:
+        return 0.8;
+    case UrlField::QueryKey:
+        return 0.7;
+    case UrlField::Scheme:
+    case UrlField::Suffix:
+        break;
+    }
+    return 0.6;
+}
+
+QStringList UrlTokenizer::words(const QString &text)
+{
+    static const QRegularExpression separator(QStringLiteral("[^\\p{L}\\p{N}]+"));
+    return text.toLower().split(separator, Qt::SkipEmptyParts);
+}
+
+bool UrlTokenizer::isTrackingParameter(const QString &key)
+{
+    static const QStringList trackingParameters{
+        QStringLiteral("fbclid"),
+        QStringLiteral("gclid"),
+        QStringLiteral("dclid"),
+        QStringLiteral("msclkid"),
+        QStringLiteral("mc_cid"),
+        QStringLiteral("mc_eid"),
+        QStringLiteral("igshid"),
+        QStringLiteral("yclid"),
+        QStringLiteral("_ga"),
+        QStringLiteral("ref"),
+        QStringLiteral("ref_src"),
+    };
+    return key.startsWith(QLatin1String("utm_"), Qt::CaseInsensitive) || trackingParameters.contains(key.toLower());
+}
+
+int UrlTokenizer::publicSuffixLabels(const QStringList &labels)
+{
+    if (labels.size() < 2) {
+        return labels.size();
+    }
+    static const QStringList secondLevelSuffixes{
+        QStringLiteral("co"),
+        QStringLiteral("com"),
+        QStringLiteral("org"),
+        QStringLiteral("net"),
+        QStringLiteral("ac"),
+        QStringLiteral("gov"),
+        QStringLiteral("edu"),
+        QStringLiteral("ne"),
+        QStringLiteral("or"),
+    };
+    // e.g. example.co.uk, but not example.com
+    const bool countryCode = labels.last().size() == 2;
+    if (labels.size() >= 3 && countryCode && secondLevelSuffixes.contains(labels.at(labels.size() - 2))) {
+        return 2;
+    }
+    return 1;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+enum class UrlField : quint8 {
+    Scheme,
+    Suffix, // Public suffix like "com" or "co.uk"
+    Domain, // Registrable domain without the suffix, e.g. "rust-lang" in doc.rust-lang.org
+    Subdomain,
+    Path,
+    QueryKey,
+};
+
+struct UrlTerm {
+    QString text;
+    UrlField field;
+};
+
+/**
+ * Splits URLs into lowercase words tagged with the part of the URL they come from. Query values are
+ * dropped and so are well known tracking parameters, they would otherwise match by accident.
+ */
+class UrlTokenizer
+{
+public:
+    static QVector<UrlTerm> tokenize(const QString &url);
+
+    /**
+     * Relevance of a match in the field, matches in the host rank above the path and the query
+     */
+    static float weight(UrlField field);
+
+    static QStringList words(const QString &text);
+    static bool isTrackingParameter(const QString &key);
+
+    /**
+     * Number of trailing host labels that form the public suffix, without a suffix list this handles
+     * generic TLDs and second level suffixes like co.uk or com.au
+     */
+    static int publicSuffixLabels(const QStringList &labels);
+};
@@ -0,0 +1,134 @@
+#include "WordStartIndex.h"
+
+#include "BookmarkIndex.h"
+#include "UrlTokenizer.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+struct Candidate {
+    quint64 key;
+    float relevance;
+};
+
+/**
+ * A bookmark can reach the same key several times, e.g. through the title and the host, the best one counts
+ */
+void addCandidate(std::vector<Candidate> &candidates, quint64 key, float relevance)
+{
+    if (key == 0) {
+        return;
+    }
+    for (Candidate &candidate : candidates) {
+        if (candidate.key == key) {
+            candidate.relevance = std::max(candidate.relevance, relevance);
+            return;
+        }
+    }
+    candidates.push_back(Candidate{key, relevance});
+}
+
+bool isWordStart(QStringView text, qsizetype position)
+{
+    return text[position].isLetterOrNumber() && (position == 0 || !text[position - 1].isLetterOrNumber());
+}
+}
+
+/**
+ * Up to MaxAcronymLength UTF-16 units, 0 for anything else. The first unit is never 0, so the length is implied.
+ */
+quint64 WordStartIndex::key(QStringView text)
+{
+    if (text.isEmpty() || text.size() > MaxAcronymLength) {
+        return 0;
+    }
+    quint64 key = 0;
+    for (const QChar c : text) {
+        key = key << 16 | c.unicode();
+    }
+    return key;
+}
+
+void WordStartIndex::build(const QVector<Bookmark> &bookmarks)
+{
+    m_lists.clear();
+    std::vector<Candidate> candidates;
+    const auto addWordStarts = [&candidates](QStringView text, qsizetype position, float relevance) {
+        for (qsizetype length = 1; length <= MaxPrefixLength && position + length <= text.size(); ++length) {
+            if (!text[position + length - 1].isLetterOrNumber()) {
+                break;
+            }
+            addCandidate(candidates, key(text.mid(position, length)), relevance);
+        }
+    };
+
+    for (const Bookmark &bookmark : bookmarks) {
+        candidates.clear();
+        const QStringView title(bookmark.foldedTitle);
+        for (qsizetype i = 0; i < title.size(); ++i) {
+            if (isWordStart(title, i)) {
+                addWordStarts(title, i, i == 0 ? TitleStartRelevance : TitleWordRelevance);
+            }
+        }
+
+        // Registrable domain and subdomains, the public suffix would match nearly everything
+        const QStringList labels = bookmark.host.split(QLatin1Char('.'), Qt::SkipEmptyParts);
+        const int hostLabels = labels.size() - UrlTokenizer::publicSuffixLabels(labels);
+        for (int label = 0; label < hostLabels; ++label) {
+            const QStringView text(labels.at(label));
+            for (qsizetype i = 0; i < text.size(); ++i) {
+                if (isWordStart(text, i)) {
+                    addWordStarts(text, i, UrlTokenizer::weight(UrlField::Domain));
+                }
+            }
+        }
+
+        // Initials of the words and of camel case humps like the H in GitHub
+        char16_t acronym[MaxAcronymLength];
+        int acronymLength = 0;
+        const QString &original = bookmark.title;
+        for (qsizetype i = 0; i < original.size() && acronymLength < MaxAcronymLength; ++i) {
+            const bool hump = i > 0 && original.at(i).isUpper() && original.at(i - 1).isLower();
+            if (hump || isWordStart(original, i)) {
+                acronym[acronymLength++] = original.at(i).toCaseFolded().unicode();
+            }
+        }
+        for (int length = 2; length <= acronymLength; ++length) {
+            addCandidate(candidates, key(QStringView(acronym, length)), AcronymRelevance);
+        }
+
+        for (const Candidate &candidate : candidates) {
+            m_lists[candidate.key].append(Entry{bookmark.id, candidate.relevance, bookmark.frecency});
+        }
+    }
+
+    for (QVector<Entry> &entries : m_lists) {
+        const int count = std::min<int>(entries.size(), ListSize);
+        std::partial_sort(entries.begin(), entries.begin() + count, entries.end(), [](const Entry &a, const Entry &b) {
+            if (a.relevance != b.relevance) {
+                return a.relevance > b.relevance;
+            }
+            return a.frecency != b.frecency ? a.frecency > b.frecency : a.id < b.id;
+        });
+        entries.resize(count);
+        entries.squeeze();
+    }
+}
+
+const QVector<WordStartIndex::Entry> *WordStartIndex::entries(QStringView foldedPrefix) const
+{
+    const auto it = m_lists.constFind(key(foldedPrefix));
+    return it == m_lists.constEnd() ? nullptr : &it.value();
+}
+
+qint64 WordStartIndex::memoryUsage() const
+{
+    // Node plus bucket pointer, like the other hashes of BookmarkIndex
+    qint64 bytes = qint64(m_lists.size()) * (sizeof(quint64) + sizeof(QVector<Entry>) + 2 * sizeof(void *));
+    for (const QVector<Entry> &entries : m_lists) {
+        bytes += qint64(entries.capacity()) * sizeof(Entry);
+    }
+    return bytes;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QHash>
+#include <QStringView>
+#include <QVector>
+
+struct Bookmark;
+
+/**
+ * Bookmarks by the first characters of their words, for queries of one or two characters. Almost every title
+ * contains such a query somewhere, so the substring scan finds everything and ranks it by title. Here the
+ * candidates are precomputed per prefix instead: the words of the title and the labels of the host contribute
+ * their first one or two characters, the acronym of the title ("gcp" for Google Cloud Platform, "gh" for GitHub)
+ * its first two to MaxAcronymLength characters. Each list keeps the ListSize best bookmarks, ordered by
+ * relevance and frecency.
+ * The keys are case folded and packed into an integer, a lookup does not allocate.
+ */
+class WordStartIndex
+{
+public:
+    struct Entry {
+        qint64 id = 0;
+        float relevance = 0;
+        int frecency = 0;
+    };
+
+    void build(const QVector<Bookmark> &bookmarks);
+    void clear()
+    {
+        m_lists.clear();
+    }
+    bool isEmpty() const
+    {
+        return m_lists.isEmpty();
+    }
+
+    /**
+     * Best entries for the case folded prefix, nullptr if it is not a key or no bookmark matches
+     */
+    const QVector<Entry> *entries(QStringView foldedPrefix) const;
+
+    qint64 memoryUsage() const;
+
+    // Longer queries are selective enough for the substring scan
+    static constexpr int MaxPrefixLength = 2;
+    static constexpr int MaxAcronymLength = 4;
+    // More than a query shows, a list shorter than the limit of the query falls back to the scan
+    static constexpr int ListSize = 64;
+    // Nothing ranks above a title that starts with the query
+    static constexpr float TitleStartRelevance = 1.0f;
+    // A title word that does not start the title ranks like a substring match, an acronym like a match in the host
+    static constexpr float TitleWordRelevance = 0.9f;
+    static constexpr float AcronymRelevance = 0.85f;
+
+private:
+    static quint64 key(QStringView text);
+
+    QHash<quint64, QVector<Entry>> m_lists;
+};
@@ -0,0 +1,172 @@
+#include "bookmarks/BookmarkIndex.h"
+#include "bookmarks/BookmarkSearch.h"
+#include "bookmarks/PlacesDatabase.h"
+#include "bookmarks/PlacesReader.h"
+#include "bookmarks/QueryArena.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+
+#include <algorithm>
+
+struct ReplayEntry {
+    qint64 offsetMs = 0;
+    QString query;
+};
+
+/**
+ * Keystroke files contain one query per line, optionally prefixed by the time in ms since the
+ * recording started and a tab. Lines starting with # are ignored.
+ */
+static QVector<ReplayEntry> readReplayFile(const QString &path, bool &ok)
+{
+    QVector<ReplayEntry> entries;
+    QFile file(path);
+    ok = file.open(QIODevice::ReadOnly | QIODevice::Text);
+    if (!ok) {
+        return entries;
+    }
+    QTextStream stream(&file);
+    while (!stream.atEnd()) {
+        const QString line = stream.readLine();
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#'))) {
+            continue;
+        }
+        ReplayEntry entry;
+        const int tab = line.indexOf(QLatin1Char('\t'));
+        bool isNumber = false;
+        if (tab != -1) {
+            entry.offsetMs = line.left(tab).toLongLong(&isNumber);
+        }
+        entry.query = isNumber ? line.mid(tab + 1) : line;
+        entries.append(entry);
+    }
+    return entries;
+}
+
+static qint64 percentile(QVector<qint64> values, double p)
+{
+    if (values.isEmpty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values.at(std::min<int>(values.size() - 1, int(p * values.size())));
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("zen-bookmark-query"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Runs bookmark queries against a Zen profile and prints their latency and top results"));
+    parser.addHelpOption();
+    const QCommandLineOption profileOption(QStringLiteral("profile"), QStringLiteral("Zen profile directory containing places.sqlite"), QStringLiteral("dir"));
+    const QCommandLineOption replayOption(QStringLiteral("replay"), QStringLiteral("Keystroke file to replay"), QStringLiteral("file"));
+    const QCommandLineOption topOption(QStringLiteral("top"), QStringLiteral("Number of results to print per query"), QStringLiteral("n"), QStringLiteral("5"));
+    const QCommandLineOption limitOption(QStringLiteral("limit"),
+                                         QStringLiteral("Number of results to rank per query like the runner, 0 ranks all"),
+                                         QStringLiteral("n"),
+                                         QString::number(BookmarkSearch::MatchLimit));
+    const QCommandLineOption noDelayOption(QStringLiteral("no-delay"), QStringLiteral("Ignore the recorded timing and run the queries back to back"));
+    parser.addOptions({profileOption, replayOption, topOption, limitOption, noDelayOption});
+    parser.addPositionalArgument(QStringLiteral("queries"), QStringLiteral("Queries like \"b github\""), QStringLiteral("[queries...]"));
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (!parser.isSet(profileOption)) {
+        err << "Missing --profile" << Qt::endl;
+        return 1;
+    }
+
+    QVector<ReplayEntry> entries;
+    if (parser.isSet(replayOption)) {
+        bool ok = false;
+        entries = readReplayFile(parser.value(replayOption), ok);
+        if (!ok) {
+            err << "Can not read " << parser.value(replayOption) << Qt::endl;
+            return 1;
+        }
+    }
+    for (const QString &query : parser.positionalArguments()) {
+        entries.append(ReplayEntry{0, query});
+    }
+
+    const QString placesPath = QDir(parser.value(profileOption)).filePath(QStringLiteral("places.sqlite"));
+    if (!QFile::exists(placesPath)) {
+        err << "Can not find " << placesPath << Qt::endl;
+        return 1;
+    }
+
+    QElapsedTimer loadTimer;
+    loadTimer.start();
+    BookmarkIndex index;
+    PlacesReader::BuildStats build;
+    {
+        PlacesDatabase places(placesPath, QStringLiteral("zen_bookmarks_cli_"));
+        if (!places.open() || !PlacesReader::readAllParallel(places, index, &build)) {
+            err << "Can not read bookmarks from " << placesPath << Qt::endl;
+            return 1;
+        }
+    }
+    out << "Loaded " << index.size() << " bookmarks in " << loadTimer.nsecsElapsed() / 1000 << " us (reading " << build.readUs << " us, preparing "
+        << build.prepareUs << " us, inserting " << build.insertUs << " us)" << Qt::endl;
+
+    const int top = parser.value(topOption).toInt();
+    const int limit = parser.value(limitOption).toInt();
+    const bool honorTiming = !parser.isSet(noDelayOption);
+    QVector<qint64> latencies;
+    QElapsedTimer replayTimer;
+    replayTimer.start();
+    for (const ReplayEntry &entry : std::as_const(entries)) {
+        if (honorTiming && entry.offsetMs > replayTimer.elapsed()) {
+            QThread::msleep(static_cast<unsigned long>(entry.offsetMs - replayTimer.elapsed()));
+        }
+
+        // Same steps as match() of the runner, the scratch buffers are released when the query is done
+        QueryArena::Scope arenaScope;
+        QElapsedTimer timer;
+        timer.start();
+        QString filter;
+        QVector<FolderResult> folders;
+        BookmarkSearch::Results results(QueryArena::resource());
+        QString keywordUrl;
+        const BookmarkKeyword *keyword = nullptr;
+        if (BookmarkSearch::parseQuery(entry.query, filter)) {
+            keyword = BookmarkSearch::resolveKeyword(index, filter, keywordUrl);
+            if (!keyword) {
+                const BookmarkQuery query = BookmarkQuery::parse(filter);
+                folders = BookmarkSearch::folderSearch(index, query, BookmarkSearch::FolderMatchLimit);
+                BookmarkSearch::search(index, query, results, limit);
+            }
+        }
+        const qint64 latencyUs = timer.nsecsElapsed() / 1000;
+        latencies.append(latencyUs);
+
+        if (keyword) {
+            out << latencyUs << " us\tkeyword " << keyword->keyword << '\t' << entry.query << '\n';
+            out << "    " << keywordUrl << '\n';
+            continue;
+        }
+        out << latencyUs << " us\t" << folders.size() << " folders, " << results.size() << " results\t" << entry.query << '\n';
+        for (const FolderResult &folder : std::as_const(folders)) {
+            out << "    " << QString::number(folder.relevance, 'f', 2) << " folder " << folder.text() << '\n';
+        }
+        for (int i = 0; i < std::min<int>(top, int(results.size())); ++i) {
+            const SearchResult &result = results.at(i);
+            out << "    " << QString::number(result.relevance, 'f', 2) << ' ' << result.bookmark->title << " - " << result.bookmark->url << '\n';
+        }
+    }
+
+    if (!latencies.isEmpty()) {
+        out << "Queries: " << latencies.size() << ", p50: " << percentile(latencies, 0.5) << " us, p95: " << percentile(latencies, 0.95)
+            << " us, max: " << *std::max_element(latencies.cbegin(), latencies.cend()) << " us" << Qt::endl;
+    }
+    return 0;
+}
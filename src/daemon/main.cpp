@@ -0,0 +1,61 @@
+#include "bookmarks/IndexUpdater.h"
+#include "service/IndexProtocol.h"
+#include "service/IndexServer.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("zen-bookmark-daemon"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Keeps the bookmark index of a Zen profile and answers queries of the runner and other clients"));
+    parser.addHelpOption();
+    const QCommandLineOption profileOption(QStringLiteral("profile"), QStringLiteral("Zen profile directory containing places.sqlite"), QStringLiteral("dir"));
+    const QCommandLineOption socketOption(QStringLiteral("socket"),
+                                          QStringLiteral("Unix socket to listen on"),
+                                          QStringLiteral("path"),
+                                          IndexProtocol::defaultSocketPath());
+    parser.addOptions({profileOption, socketOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (!parser.isSet(profileOption)) {
+        err << "Missing --profile" << Qt::endl;
+        return 1;
+    }
+    const QString placesPath = QDir(parser.value(profileOption)).filePath(QStringLiteral("places.sqlite"));
+    if (!QFile::exists(placesPath)) {
+        err << "Can not find " << placesPath << Qt::endl;
+        return 1;
+    }
+
+    // Load before listening, so that the first clients do not fall back to their own index
+    QElapsedTimer loadTimer;
+    loadTimer.start();
+    IndexUpdater updater;
+    updater.setSourcePath(placesPath);
+    updater.scheduleRefresh();
+    updater.waitForDone();
+    if (const auto index = updater.acquire()) {
+        out << "Loaded " << index->size() << " bookmarks in " << loadTimer.nsecsElapsed() / 1000 << " us" << Qt::endl;
+    } else {
+        err << "Can not read bookmarks from " << placesPath << Qt::endl;
+        return 1;
+    }
+
+    IndexServer server(updater);
+    if (!server.listen(parser.value(socketOption))) {
+        err << server.errorString() << Qt::endl;
+        return 1;
+    }
+    out << "Listening on " << parser.value(socketOption) << Qt::endl;
+    return app.exec();
+}
@@ -0,0 +1,93 @@
+#include "StatsService.h"
+
+#include "firefox_debug.h"
+
+#include <QDBusConnectionInterface>
+
+#include <algorithm>
+
+StatsService::~StatsService()
+{
+    if (m_connectionName.isEmpty()) {
+        return;
+    }
+    QDBusConnection connection(m_connectionName);
+    connection.unregisterObject(ObjectPath);
+    if (!m_serviceName.isEmpty()) {
+        connection.unregisterService(m_serviceName);
+    }
+}
+
+bool StatsService::registerOn(const QDBusConnection &connection, const QString &serviceName)
+{
+    if (!connection.isConnected()) {
+        qCDebug(FIREFOX) << "No D-Bus connection, stats are not exported";
+        return false;
+    }
+    QDBusConnection bus(connection);
+    if (!bus.registerObject(ObjectPath, this, QDBusConnection::ExportScriptableSlots)) {
+        qCDebug(FIREFOX) << "Can not register" << ObjectPath << bus.lastError().message();
+        return false;
+    }
+    m_connectionName = bus.name();
+    if (!serviceName.isEmpty() && bus.registerService(serviceName)) {
+        m_serviceName = serviceName;
+    } else {
+        qCDebug(FIREFOX) << "Stats are only reachable as" << bus.baseService() << ObjectPath;
+    }
+    return true;
+}
+
+void StatsService::setStatsProvider(const std::function<QVariantMap()> &provider)
+{
+    QMutexLocker locker(&m_mutex);
+    m_provider = provider;
+}
+
+void StatsService::recordQuery(qint64 latencyUs)
+{
+    const quint64 slot = m_queryCount.fetch_add(1, std::memory_order_relaxed) % RecentQueryCount;
+    m_latencies[slot].store(latencyUs, std::memory_order_relaxed);
+}
+
+QVariantMap StatsService::Stats() const
+{
+    std::function<QVariantMap()> provider;
+    {
+        QMutexLocker locker(&m_mutex);
+        provider = m_provider;
+    }
+    // Oldest first, the ring buffer wraps once it is full
+    const quint64 queryCount = m_queryCount.load(std::memory_order_relaxed);
+    const quint64 recentCount = std::min<quint64>(queryCount, RecentQueryCount);
+    QVector<qint64> latencies;
+    latencies.reserve(int(recentCount));
+    for (quint64 query = queryCount - recentCount; query < queryCount; ++query) {
+        latencies.append(m_latencies[query % RecentQueryCount].load(std::memory_order_relaxed));
+    }
+
+    QVariantMap stats = provider ? provider() : QVariantMap();
+    stats.insert(QStringLiteral("queryCount"), queryCount);
+    QVariantList recent;
+    recent.reserve(latencies.size());
+    for (const qint64 latency : std::as_const(latencies)) {
+        recent.append(latency);
+    }
+    stats.insert(QStringLiteral("recentQueryLatenciesUs"), recent);
+    if (!latencies.isEmpty()) {
+        std::sort(latencies.begin(), latencies.end());
+        stats.insert(QStringLiteral("queryLatencyP50Us"), latencies.at(latencies.size() / 2));
+        stats.insert(QStringLiteral("queryLatencyP95Us"), latencies.at(std::min<int>(latencies.size() - 1, latencies.size() * 95 / 100)));
+    }
+    return stats;
+}
+
+void StatsService::Reindex()
+{
+    Q_EMIT reindexRequested();
+}
+
+void StatsService::DropCaches()
+{
+    Q_EMIT dropCachesRequested();
+}
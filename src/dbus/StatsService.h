@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QDBusConnection>
+#include <QMutex>
+#include <QObject>
+#include <QVariantMap>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
+
+/**
+ * Session bus object to look into the runner while it runs inside krunner, e.g.
+ * "qdbus org.kde.zenbookmark /ZenBookmark Stats". The runner provides the statistics, reindexing and dropping
+ * the caches is forwarded to it as signals. Only the recent query latencies are recorded here.
+ */
+class StatsService : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.zenbookmark.Stats")
+
+public:
+    static inline const QString DefaultServiceName = QStringLiteral("org.kde.zenbookmark");
+    static inline const QString ObjectPath = QStringLiteral("/ZenBookmark");
+    static constexpr int RecentQueryCount = 64;
+
+    explicit StatsService(QObject *parent = nullptr)
+        : QObject(parent)
+    {
+    }
+    ~StatsService() override;
+
+    /**
+     * Export the object on the connection. The service name is optional, another process that loads the
+     * runner (like plasmashell next to krunner) might own it already.
+     */
+    bool registerOn(const QDBusConnection &connection, const QString &serviceName = DefaultServiceName);
+
+    void setStatsProvider(const std::function<QVariantMap()> &provider);
+    /**
+     * Called at the end of every match(), it only claims a slot and stores into it without locking
+     */
+    void recordQuery(qint64 latencyUs);
+
+public Q_SLOTS:
+    /**
+     * Statistics of the provider and the latencies of the recent queries in microseconds, oldest first
+     */
+    Q_SCRIPTABLE QVariantMap Stats() const;
+    Q_SCRIPTABLE void Reindex();
+    Q_SCRIPTABLE void DropCaches();
+
+Q_SIGNALS:
+    void reindexRequested();
+    void dropCachesRequested();
+
+private:
+    mutable QMutex m_mutex;
+    std::function<QVariantMap()> m_provider;
+    // Ring buffer, the query count selects the next slot. Stats() reads it without synchronizing, a query
+    // that claimed its slot but did not store yet shows the latency of the query one round before.
+    std::atomic<qint64> m_latencies[RecentQueryCount] = {};
+    std::atomic<quint64> m_queryCount{0};
+
+    QString m_connectionName;
+    QString m_serviceName;
+};
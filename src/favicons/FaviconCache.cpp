@@ -0,0 +1,387 @@
+#include "FaviconCache.h"
+
+#include "MozHash.h"
+#include "firefox_debug.h"
+#include <QBuffer>
+#include <QImageReader>
+#include <QMutexLocker>
+#include <QPixmap>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+
+// Prefer the smallest icon that is still large enough, Zen stores SVG icons with a width of 65535.
+// If all icons are smaller than the display size the largest one is used.
+static const QString iconColumns = QStringLiteral(
+    "SELECT i.id, i.data FROM moz_icons i "
+    "JOIN moz_icons_to_pages itp ON i.id = itp.icon_id "
+    "JOIN moz_pages_w_icons p ON itp.page_id = p.id ");
+static const QString iconOrder = QStringLiteral(
+    " AND i.data IS NOT NULL "
+    "ORDER BY i.width < ?, CASE WHEN i.width >= ? THEN i.width ELSE -i.width END LIMIT 1");
+
+QIcon FaviconCache::icon(const QString &url, const QSqlDatabase &faviconDb)
+{
+    QString missStatePath;
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto it = m_pageIcons.constFind(url);
+        if (it != m_pageIcons.constEnd()) {
+            ++m_hits;
+            return it.value();
+        }
+        ++m_misses;
+        if (!m_missState) {
+            missStatePath = m_sourcePath;
+        }
+    }
+
+    // Taken before the lookup, so that a change during it invalidates the miss
+    std::optional<PlacesDatabase::SourceState> sourceState;
+    if (!missStatePath.isEmpty()) {
+        sourceState = PlacesDatabase::sourceState(missStatePath);
+    }
+    const IconData iconData = queryIcon(url, faviconDb);
+    if (iconData.id != 0) {
+        QMutexLocker locker(&m_mutex);
+        if (const auto it = m_icons.constFind(iconData.id); it != m_icons.constEnd()) {
+            m_pageIcons.insert(url, it.value());
+            return it.value();
+        }
+    }
+
+    // Decode outside of the lock, concurrent queries should not wait for each other
+    const QImage image = iconData.id == 0 ? QImage() : decode(iconData.data, m_iconSize);
+    QMutexLocker locker(&m_mutex);
+    if (image.isNull()) {
+        if (iconData.id != 0) {
+            qCDebug(FIREFOX) << "Failed to decode favicon for" << url;
+        }
+        m_pageIcons.insert(url, QIcon());
+        if (!m_missState) {
+            m_missState = sourceState;
+        }
+        return QIcon();
+    }
+    // Another thread might have decoded the same icon meanwhile
+    const auto it = m_icons.constFind(iconData.id);
+    if (it != m_icons.constEnd()) {
+        m_pageIcons.insert(url, it.value());
+        return it.value();
+    }
+    const QIcon icon(QPixmap::fromImage(image));
+    m_pageIcons.insert(url, icon);
+    m_icons.insert(iconData.id, icon);
+    m_memoryUsage += image.sizeInBytes();
+    return icon;
+}
+
+bool FaviconCache::cachedIcon(const QString &url, QIcon &icon)
+{
+    const auto pageIcons = m_published.acquire();
+    const auto it = pageIcons ? pageIcons->constFind(url) : PageIcons::const_iterator();
+    if (!pageIcons || it == pageIcons->constEnd()) {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    icon = it.value();
+    return true;
+}
+
+void FaviconCache::publish()
+{
+    QMutexLocker locker(&m_mutex);
+    publishLocked();
+}
+
+/**
+ * The copy shares the data of m_pageIcons until the next lookup detaches it
+ */
+void FaviconCache::publishLocked()
+{
+    m_published.publish(std::make_shared<const PageIcons>(m_pageIcons));
+}
+
+void FaviconCache::setSourcePath(const QString &faviconsPath)
+{
+    QMutexLocker locker(&m_mutex);
+    if (faviconsPath != m_sourcePath) {
+        m_sourcePath = faviconsPath;
+        m_missState.reset();
+    }
+}
+
+bool FaviconCache::dropStaleMisses()
+{
+    QString path;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_missState) {
+            return false;
+        }
+        path = m_sourcePath;
+    }
+    const PlacesDatabase::SourceState state = PlacesDatabase::sourceState(path);
+    QMutexLocker locker(&m_mutex);
+    if (!m_missState || *m_missState == state) {
+        return false;
+    }
+    int dropped = 0;
+    for (auto it = m_pageIcons.begin(); it != m_pageIcons.end();) {
+        if (it.value().isNull()) {
+            it = m_pageIcons.erase(it);
+            ++dropped;
+        } else {
+            ++it;
+        }
+    }
+    m_missState.reset();
+    // The site icons the misses fall back to might have changed as well
+    m_hostIcons.clear();
+    m_hostMapBuilt = false;
+    publishLocked();
+    qCDebug(FIREFOX) << "favicons.sqlite changed, dropped" << dropped << "pages without icon";
+    return dropped > 0;
+}
+
+bool FaviconCache::contains(const QString &url) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pageIcons.contains(url);
+}
+
+void FaviconCache::setIconSize(int iconSize)
+{
+    QMutexLocker locker(&m_mutex);
+    if (iconSize != m_iconSize) {
+        m_iconSize = iconSize;
+        m_pageIcons.clear();
+        m_icons.clear();
+        m_memoryUsage = 0;
+        m_missState.reset();
+        // The best icon of a host depends on the size
+        m_hostIcons.clear();
+        m_hostMapBuilt = false;
+        publishLocked();
+    }
+}
+
+void FaviconCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_pageIcons.clear();
+    m_icons.clear();
+    m_memoryUsage = 0;
+    m_missState.reset();
+    m_hostIcons.clear();
+    m_hostMapBuilt = false;
+    publishLocked();
+}
+
+int FaviconCache::iconCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_icons.size();
+}
+
+quint64 FaviconCache::hits() const
+{
+    return m_hits.load(std::memory_order_relaxed);
+}
+
+quint64 FaviconCache::misses() const
+{
+    return m_misses.load(std::memory_order_relaxed);
+}
+
+qint64 FaviconCache::memoryUsage() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_memoryUsage;
+}
+
+/**
+ * Decode the icon data directly into the target size. SVG icons are rendered at the target size
+ * and raster icons are only downscaled, the result is premultiplied so painting it needs no conversion.
+ */
+QImage FaviconCache::decode(const QByteArray &data, int size)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    reader.setDecideFormatFromContent(true);
+
+    const QSize original = reader.size();
+    const bool isVector = reader.format().startsWith("svg");
+    if (original.isValid() && (isVector || original.width() > size || original.height() > size)) {
+        reader.setScaledSize(original.scaled(size, size, Qt::KeepAspectRatio));
+    }
+    QImage image = reader.read();
+    if (image.isNull()) {
+        return image;
+    }
+    // Not all image plugins support scaled reading, e.g. ICO
+    if (image.width() > size || image.height() > size) {
+        image = image.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    return image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
+/**
+ * Host of an URL without parsing the whole URL, this runs for every page in favicons.sqlite
+ */
+QStringView FaviconCache::hostOfUrl(QStringView url)
+{
+    const auto schemeEnd = url.indexOf(QLatin1String("://"));
+    if (schemeEnd == -1) {
+        return QStringView();
+    }
+    QStringView authority = url.mid(schemeEnd + 3);
+    for (qsizetype i = 0; i < authority.size(); ++i) {
+        const QChar c = authority.at(i);
+        if (c == QLatin1Char('/') || c == QLatin1Char('?') || c == QLatin1Char('#')) {
+            authority = authority.left(i);
+            break;
+        }
+    }
+    if (const auto at = authority.lastIndexOf(QLatin1Char('@')); at != -1) {
+        authority = authority.mid(at + 1);
+    }
+    if (const auto port = authority.lastIndexOf(QLatin1Char(':')); port != -1 && !authority.endsWith(QLatin1Char(']'))) {
+        authority = authority.left(port);
+    }
+    return authority;
+}
+
+static QString hostKey(QStringView host)
+{
+    if (host.startsWith(QLatin1String("www."), Qt::CaseInsensitive)) {
+        host = host.mid(4);
+    }
+    return host.toString().toLower();
+}
+
+void FaviconCache::buildHostMap(const QSqlDatabase &faviconDb)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_hostMapBuilt) {
+            return;
+        }
+    }
+
+    QHash<QString, HostIcon> hostIcons;
+    const auto consider = [this, &hostIcons](const QString &host, qint64 id, int width) {
+        if (host.isEmpty()) {
+            return;
+        }
+        HostIcon &current = hostIcons[host];
+        if (current.id == 0 || isBetterSize(width, current.width)) {
+            current.id = id;
+            current.width = width;
+        }
+    };
+
+    // Root icons are the /favicon.ico of a site, their fixed_icon_url has no scheme and no "www."
+    QSqlQuery rootQuery(faviconDb);
+    rootQuery.setForwardOnly(true);
+    if (rootQuery.exec(QStringLiteral("SELECT id, fixed_icon_url, width FROM moz_icons WHERE root = 1 AND data IS NOT NULL"))) {
+        while (rootQuery.next()) {
+            const QString fixedUrl = rootQuery.value(1).toString();
+            consider(hostKey(QStringView(fixedUrl).left(fixedUrl.indexOf(QLatin1Char('/')))), rootQuery.value(0).toLongLong(), rootQuery.value(2).toInt());
+        }
+    }
+
+    QSqlQuery pageQuery(faviconDb);
+    pageQuery.setForwardOnly(true);
+    if (pageQuery.exec(QStringLiteral("SELECT p.page_url, i.id, i.width FROM moz_pages_w_icons p "
+                                      "JOIN moz_icons_to_pages itp ON itp.page_id = p.id "
+                                      "JOIN moz_icons i ON i.id = itp.icon_id WHERE i.data IS NOT NULL"))) {
+        while (pageQuery.next()) {
+            const QString pageUrl = pageQuery.value(0).toString();
+            consider(hostKey(hostOfUrl(pageUrl)), pageQuery.value(1).toLongLong(), pageQuery.value(2).toInt());
+        }
+    } else {
+        qCDebug(FIREFOX) << "Failed to read favicon hosts:" << pageQuery.lastError().text();
+    }
+
+    qCDebug(FIREFOX) << "Built favicon host map with" << hostIcons.size() << "hosts";
+    QMutexLocker locker(&m_mutex);
+    m_hostIcons = std::move(hostIcons);
+    m_hostMapBuilt = true;
+}
+
+/**
+ * Icon id of the host or the closest parent domain, e.g. docs.github.com falls back to github.com
+ */
+qint64 FaviconCache::hostIconId(const QString &url) const
+{
+    QString host = hostKey(hostOfUrl(url));
+    QMutexLocker locker(&m_mutex);
+    while (!host.isEmpty()) {
+        if (const auto it = m_hostIcons.constFind(host); it != m_hostIcons.constEnd()) {
+            return it->id;
+        }
+        const auto dot = host.indexOf(QLatin1Char('.'));
+        // Do not fall back to top level domains
+        if (dot == -1 || host.indexOf(QLatin1Char('.'), dot + 1) == -1) {
+            break;
+        }
+        host.remove(0, dot + 1);
+    }
+    return 0;
+}
+
+/**
+ * Same order as the SQL queries: the smallest icon that is at least as large as the display size, otherwise the largest
+ */
+bool FaviconCache::isBetterSize(int width, int currentWidth) const
+{
+    const bool largeEnough = width >= m_iconSize;
+    const bool currentLargeEnough = currentWidth >= m_iconSize;
+    if (largeEnough != currentLargeEnough) {
+        return largeEnough;
+    }
+    return largeEnough ? width < currentWidth : width > currentWidth;
+}
+
+FaviconCache::IconData FaviconCache::queryIcon(const QString &url, const QSqlDatabase &faviconDb)
+{
+    IconData iconData;
+    // page_url_hash is indexed, the URL comparison only resolves hash collisions
+    QSqlQuery query(faviconDb);
+    query.prepare(iconColumns + "WHERE p.page_url_hash = ? AND p.page_url = ?" + iconOrder);
+    query.addBindValue(static_cast<qint64>(MozHash::hashUrl(url)));
+    query.addBindValue(url);
+    query.addBindValue(m_iconSize);
+    query.addBindValue(m_iconSize);
+    if (!query.exec()) {
+        qCDebug(FIREFOX) << "Favicon query failed:" << query.lastError().text();
+    } else if (query.next()) {
+        iconData.id = query.value(0).toLongLong();
+        iconData.data = query.value(1).toByteArray();
+        return iconData;
+    }
+
+    // Pages without an icon of their own use the icon of their site
+    buildHostMap(faviconDb);
+    iconData.id = hostIconId(url);
+    if (iconData.id == 0) {
+        return iconData;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_icons.contains(iconData.id)) {
+            return iconData;
+        }
+    }
+    QSqlQuery dataQuery(faviconDb);
+    dataQuery.prepare(QStringLiteral("SELECT data FROM moz_icons WHERE id = ?"));
+    dataQuery.addBindValue(iconData.id);
+    if (dataQuery.exec() && dataQuery.next()) {
+        iconData.data = dataQuery.value(0).toByteArray();
+    }
+    return iconData;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "bookmarks/PlacesDatabase.h"
+#include "bookmarks/SnapshotPublisher.h"
+
+#include <QHash>
+#include <QIcon>
+#include <QImage>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QString>
+
+#include <atomic>
+#include <optional>
+
+/**
+ * Decoded favicons from favicons.sqlite. Each icon is read once in the smallest stored size that is at least
+ * as large as the display size, rasterized and downscaled to that size and kept as a premultiplied pixmap.
+ */
+class FaviconCache
+{
+public:
+    explicit FaviconCache(int iconSize = 32)
+        : m_iconSize(iconSize)
+    {
+    }
+
+    /**
+     * Get the icon for the page, the database is only queried if the URL was not looked up before.
+     * A null icon is returned if Zen has no icon for the page. cachedIcon() finds it after the next publish().
+     */
+    QIcon icon(const QString &url, const QSqlDatabase &faviconDb);
+    /**
+     * Icon of a page that was looked up and published before, the database is never queried. Returns false if
+     * the page was not looked up yet, e.g. to leave it to the prefetch. Queries call this for every result,
+     * it reads the published pages without locking.
+     */
+    bool cachedIcon(const QString &url, QIcon &icon);
+    /**
+     * Make the pages looked up since the last call visible to cachedIcon()
+     */
+    void publish();
+    bool contains(const QString &url) const;
+
+    /**
+     * Read the best icon of each host, pages without an icon of their own fall back to it.
+     * This scans favicons.sqlite once, it does nothing if the map is already built.
+     */
+    void buildHostMap(const QSqlDatabase &faviconDb);
+
+    /**
+     * favicons.sqlite, its state is recorded with the pages that have no icon
+     */
+    void setSourcePath(const QString &faviconsPath);
+    /**
+     * Forget the pages without an icon if favicons.sqlite changed since they were looked up, Zen might have
+     * stored their icons by now. Returns whether any were dropped.
+     */
+    bool dropStaleMisses();
+
+    void setIconSize(int iconSize);
+    int iconSize() const
+    {
+        return m_iconSize;
+    }
+    void clear();
+    qint64 memoryUsage() const;
+    int iconCount() const;
+    // Lookups that were answered from the cache and lookups that queried the database
+    quint64 hits() const;
+    quint64 misses() const;
+
+    static QImage decode(const QByteArray &data, int size);
+    static QStringView hostOfUrl(QStringView url);
+
+private:
+    struct IconData {
+        qint64 id = 0;
+        QByteArray data;
+    };
+    struct HostIcon {
+        qint64 id = 0;
+        int width = 0;
+    };
+    IconData queryIcon(const QString &url, const QSqlDatabase &faviconDb);
+    qint64 hostIconId(const QString &url) const;
+    bool isBetterSize(int width, int currentWidth) const;
+
+    using PageIcons = QHash<QString, QIcon>;
+    void publishLocked();
+
+    int m_iconSize;
+    mutable QMutex m_mutex;
+    // Icons of the looked up pages, null for pages without an icon. Pages usually share the icon of their
+    // site, the decoded icons are stored once per moz_icons.id.
+    PageIcons m_pageIcons;
+    QHash<qint64, QIcon> m_icons;
+    qint64 m_memoryUsage = 0;
+    // Copy of m_pageIcons for the queries, published in batches by the writers that hold m_mutex
+    SnapshotPublisher<PageIcons> m_published;
+    std::atomic<quint64> m_hits{0};
+    std::atomic<quint64> m_misses{0};
+    // Keys are lowercase hosts without "www.", like the fixed_icon_url of root icons
+    QHash<QString, HostIcon> m_hostIcons;
+    bool m_hostMapBuilt = false;
+    QString m_sourcePath;
+    // State of the source before the first cached miss was looked up
+    std::optional<PlacesDatabase::SourceState> m_missState;
+};
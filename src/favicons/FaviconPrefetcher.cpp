@@ -0,0 +1,101 @@
+#include "FaviconPrefetcher.h"
+
+#include "FaviconCache.h"
+#include "bookmarks/PlacesDatabase.h"
+#include "firefox_debug.h"
+#include <QElapsedTimer>
+#include <QScopeGuard>
+#include <QThread>
+
+FaviconPrefetcher::FaviconPrefetcher(FaviconCache &cache)
+    : m_cache(cache)
+{
+    m_pool.setMaxThreadCount(1);
+    m_pool.setExpiryTimeout(5000);
+}
+
+FaviconPrefetcher::~FaviconPrefetcher()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void FaviconPrefetcher::schedule(const QString &faviconsPath, const QStringList &urls)
+{
+    const quint64 generation = ++m_generation;
+    if (urls.isEmpty()) {
+        return;
+    }
+    m_pool.start([this, faviconsPath, urls, generation]() {
+        prefetch(faviconsPath, urls, generation);
+    });
+}
+
+void FaviconPrefetcher::cancel()
+{
+    ++m_generation;
+}
+
+void FaviconPrefetcher::waitForDone()
+{
+    m_pool.waitForDone();
+}
+
+/**
+ * Queries have priority, they use the same cache and CPU. Returns false if the prefetch was cancelled meanwhile.
+ */
+bool FaviconPrefetcher::waitForQueries(quint64 generation) const
+{
+    while (m_activeQueries.load() > 0 && !isCancelled(generation)) {
+        QThread::msleep(10);
+    }
+    return !isCancelled(generation);
+}
+
+void FaviconPrefetcher::prefetch(const QString &faviconsPath, const QStringList &urls, quint64 generation)
+{
+    if (isCancelled(generation)) {
+        return;
+    }
+    QThread::currentThread()->setPriority(QThread::IdlePriority);
+    // A query that scheduled the prefetch might still run, it should not wait for the copy of the database
+    if (!waitForQueries(generation)) {
+        return;
+    }
+
+    PlacesDatabase favicons(faviconsPath, QStringLiteral("zen_favicons_prefetch_"));
+    if (!favicons.open()) {
+        return;
+    }
+    m_cache.buildHostMap(favicons.database());
+    // Queries only see the icons once they are published, also when the prefetch is cancelled
+    const auto publish = qScopeGuard([this]() {
+        m_cache.publish();
+    });
+
+    QElapsedTimer total;
+    total.start();
+    int fetched = 0;
+    for (const QString &url : urls) {
+        if (fetched >= maxIcons || m_cache.memoryUsage() >= memoryBudget) {
+            break;
+        }
+        if (!waitForQueries(generation)) {
+            return;
+        }
+        if (m_cache.contains(url)) {
+            continue;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        m_cache.icon(url, favicons.database());
+        if (++fetched % publishInterval == 0) {
+            m_cache.publish();
+        }
+        // Sleep in proportion to the work done to stay within the CPU share
+        const qint64 busyUs = timer.nsecsElapsed() / 1000;
+        QThread::usleep(static_cast<unsigned long>(busyUs * (1.0 - cpuShare) / cpuShare));
+    }
+    qCDebug(FIREFOX) << "Prefetched" << fetched << "favicons in" << total.elapsed() << "ms," << m_cache.memoryUsage() << "bytes cached";
+}
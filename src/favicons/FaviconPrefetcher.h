@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <atomic>
+
+class FaviconCache;
+
+/**
+ * Resolves and decodes favicons on a low priority background thread, so that the first queries
+ * already find the icons in the cache. The work pauses while queries are running and stops once
+ * the memory budget of the cache is reached.
+ */
+class FaviconPrefetcher
+{
+public:
+    explicit FaviconPrefetcher(FaviconCache &cache);
+    ~FaviconPrefetcher();
+    Q_DISABLE_COPY(FaviconPrefetcher)
+
+    /**
+     * Prefetch the icons of the given URLs in order, a previously scheduled prefetch is cancelled
+     */
+    void schedule(const QString &faviconsPath, const QStringList &urls);
+    void cancel();
+    /**
+     * Block until the scheduled prefetch is done, used by the tests
+     */
+    void waitForDone();
+
+    /**
+     * Marks a running query, the prefetch yields as long as one exists
+     */
+    class QueryGuard
+    {
+    public:
+        explicit QueryGuard(FaviconPrefetcher &prefetcher)
+            : m_prefetcher(prefetcher)
+        {
+            ++m_prefetcher.m_activeQueries;
+        }
+        ~QueryGuard()
+        {
+            --m_prefetcher.m_activeQueries;
+        }
+        Q_DISABLE_COPY(QueryGuard)
+
+    private:
+        FaviconPrefetcher &m_prefetcher;
+    };
+
+    int maxIcons = 200;
+    qint64 memoryBudget = 4 * 1024 * 1024;
+    // Fraction of one core the prefetch may use while it is not paused
+    double cpuShare = 0.25;
+    // Icons fetched before they are published to the queries, each publish copies the map of the cache
+    int publishInterval = 20;
+
+private:
+    void prefetch(const QString &faviconsPath, const QStringList &urls, quint64 generation);
+    bool waitForQueries(quint64 generation) const;
+    bool isCancelled(quint64 generation) const
+    {
+        return m_generation.load() != generation;
+    }
+
+    FaviconCache &m_cache;
+    QThreadPool m_pool;
+    std::atomic<int> m_activeQueries{0};
+    std::atomic<quint64> m_generation{0};
+};
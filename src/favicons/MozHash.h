@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+#include <algorithm>
+
+/**
+ * Reimplementation of the hash() SQL function that Firefox registers for its databases. The page_url_hash
+ * columns are indexed, so lookups by hash avoid a full table scan over the URLs.
+ */
+namespace MozHash
+{
+// mozilla::HashString from mfbt/HashFunctions.h
+inline quint32 hashString(const char *data, qsizetype length)
+{
+    constexpr quint32 goldenRatio = 0x9E3779B9U;
+    quint32 hash = 0;
+    for (qsizetype i = 0; i < length; ++i) {
+        const quint32 rotated = (hash << 5) | (hash >> 27);
+        hash = goldenRatio * (rotated ^ static_cast<quint8>(data[i]));
+    }
+    return hash;
+}
+
+// HashURL from toolkit/components/places/Helpers.cpp: 16 bits of the scheme hash followed by 32 bits of the URL hash
+inline quint64 hashUrl(const QString &url)
+{
+    constexpr qsizetype maxLengthToHash = 1500;
+    const QByteArray spec = url.toUtf8();
+    const quint32 urlHash = hashString(spec.constData(), std::min<qsizetype>(spec.size(), maxLengthToHash));
+    // Only the head of the spec is searched for the scheme
+    constexpr qsizetype maxSchemeLength = 50;
+    const qsizetype colon = spec.left(maxSchemeLength).indexOf(':');
+    if (colon == -1) {
+        return urlHash;
+    }
+    const quint64 prefixHash = hashString(spec.constData(), colon) & 0x0000FFFF;
+    return (prefixHash << 32) + urlHash;
+}
+}
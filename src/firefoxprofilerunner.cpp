@@ -1,20 +1,31 @@
 #include "firefoxprofilerunner.h"
+#include "Config.h"
 
 #include <KConfigGroup>
 #include <KLocalizedString>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
+#include <QGuiApplication>
 #include <QIcon>
-#include <QProcess>
 #include <QSqlDatabase>
 #include <QSqlQuery>
-#include <QUrl>
 #include <QSqlError>
-#include <QThread>
-#include <QTemporaryFile>
-#include <QDateTime>
-#include <QIODevice>
+#include <QMutexLocker>
+#include <QTimer>
+#include <QDBusConnection>
+#include <QElapsedTimer>
+
+#include "bookmarks/BookmarkSearch.h"
+#include "bookmarks/MatchPayload.h"
+#include "bookmarks/PlacesDatabase.h"
+#include "bookmarks/PlacesReader.h"
+#include "bookmarks/QueryArena.h"
+
+#include <algorithm>
+
+// Folders have no favicon, the same icon is used for the own and the daemon's matches
+static const QString folderIconName = QStringLiteral("folder-bookmark");
 
 ZenBookmarkRunner::ZenBookmarkRunner(QObject *parent, const KPluginMetaData &data, const QVariantList &)
 #if KRUNNER_VERSION_MAJOR == 5
@@ -25,6 +36,76 @@ ZenBookmarkRunner::ZenBookmarkRunner(QObject *parent, const KPluginMetaData &dat
     , zenIcon("bookmarks")
 #endif
 {
+    indexUpdater.setPublishedCallback([this](const BookmarkIndex &index) {
+        prefetchFavicons(index);
+    });
+
+    idleTimer = new QTimer(this);
+    idleTimer->setSingleShot(true);
+    connect(idleTimer, &QTimer::timeout, this, &ZenBookmarkRunner::releaseCaches);
+    connect(this, &AbstractRunner::prepare, this, &ZenBookmarkRunner::warmUp);
+
+    statsService.setStatsProvider([this]() {
+        return collectStats();
+    });
+    connect(&statsService, &StatsService::reindexRequested, this, [this]() {
+        if (QFile::exists(zenBookmarksPath)) {
+            indexUpdater.scheduleRefresh(true);
+        }
+    });
+    connect(&statsService, &StatsService::dropCachesRequested, this, &ZenBookmarkRunner::releaseCaches);
+    statsService.registerOn(QDBusConnection::sessionBus());
+    connect(this, &AbstractRunner::teardown, this, [this]() {
+        if (idleEvictionSeconds > 0) {
+            idleTimer->start(idleEvictionSeconds * 1000);
+        }
+    });
+}
+
+/**
+ * KRunner was opened, load or validate the index before the user typed the trigger word
+ */
+void ZenBookmarkRunner::warmUp()
+{
+    idleTimer->stop();
+    if (zenBookmarksPath.isEmpty() || !QFile::exists(zenBookmarksPath)) {
+        return;
+    }
+    // The daemon has the index loaded, the own one is only needed as fallback
+    if (useIndexDaemon && indexClient.isAvailable()) {
+        return;
+    }
+    indexUpdater.scheduleRefresh();
+    // The icons might have been released while the index stayed valid, or Zen stored icons that were missing
+    indexUpdater.runInBackground([this]() {
+        const bool missesDropped = faviconCache.dropStaleMisses();
+        if (const auto snapshot = indexUpdater.acquire(); snapshot && (missesDropped || faviconCache.memoryUsage() == 0)) {
+            prefetchFavicons(*snapshot);
+        }
+    });
+}
+
+/**
+ * KRunner was not used for the configured time, release the index and the decoded icons.
+ * The next session loads them again in warmUp().
+ */
+void ZenBookmarkRunner::releaseCaches()
+{
+    faviconPrefetcher.cancel();
+    indexUpdater.runInBackground([this]() {
+        indexUpdater.release();
+        faviconCache.clear();
+        openTabs.clear();
+        PlacesDatabase::releaseSnapshots();
+        qDebug() << "Released bookmark index and favicon cache after being idle";
+    });
+}
+
+void ZenBookmarkRunner::waitForBackgroundWork()
+{
+    // A refresh schedules the prefetch when it publishes
+    indexUpdater.waitForDone();
+    faviconPrefetcher.waitForDone();
 }
 
 void ZenBookmarkRunner::reloadConfiguration()
@@ -36,10 +117,26 @@ void ZenBookmarkRunner::reloadConfiguration()
     // Also set favicon database path
     QString zenProfilePath = homeDir + "/.var/app/app.zen_browser.zen/.zen/cr6uussi.Default (release)";
     zenFaviconsPath = zenProfilePath + "/favicons.sqlite";
+    zenSessionPath = zenProfilePath + "/sessionstore-backups/recovery.jsonlz4";
+    indexUpdater.setSourcePath(zenBookmarksPath);
+    faviconCache.setSourcePath(zenFaviconsPath);
+
+    // The installation could have changed, resolve the launch command again on next run
+    launcher.invalidate();
+
+    idleEvictionSeconds = config().readEntry(Config::IdleEvictionSeconds, Config::IdleEvictionSecondsDefault);
+    useIndexDaemon = config().readEntry(Config::UseIndexDaemon, false);
+
+    // Favicons are prepared in the size KRunner displays them
+    const qreal devicePixelRatio = qGuiApp ? qGuiApp->devicePixelRatio() : 1.0;
+    faviconCache.setIconSize(qRound(FaviconDisplaySize * devicePixelRatio));
 
     QList<RunnerSyntax> syntaxes;
-    syntaxes.append(RunnerSyntax("b :q:", "Plugin gets triggered by b... search for bookmarks by title or URL"));
+    syntaxes.append(RunnerSyntax("b :q:",
+                                 "Plugin gets triggered by b... search for bookmarks by title or URL, "
+                                 "supports site:, folder:, tag:, -exclude and \"quoted phrases\""));
     syntaxes.append(RunnerSyntax("bookmark :q:", "Plugin gets triggered by bookmark... search for bookmarks by title or URL"));
+    syntaxes.append(RunnerSyntax("t :q:", "Plugin gets triggered by t... search for tabs that are open in Zen"));
     setSyntaxes(syntaxes);
 }
 
@@ -49,46 +146,49 @@ void ZenBookmarkRunner::match(RunnerContext &context)
     if (!context.isValid()) {
         return;
     }
-    if (!term.startsWith(shortPrefix, Qt::CaseInsensitive) && !term.startsWith(mediumPrefix, Qt::CaseInsensitive)) {
+    QElapsedTimer timer;
+    timer.start();
+    // Scratch buffers of the search are released in one go when the query is done
+    QueryArena::Scope arenaScope;
+    QString filter;
+    if (BookmarkSearch::parseQuery(term, filter)) {
+        context.addMatches(createBookmarkMatches(filter));
+    } else if (OpenTabs::parseQuery(term, filter)) {
+        context.addMatches(createTabMatches(filter));
+    } else {
         return;
     }
-
-    const QString filter = filterRegex.match(term).captured(1);
-    QList<QueryMatch> matches = createBookmarkMatches(filter);
-    context.addMatches(matches);
+    statsService.recordQuery(timer.nsecsElapsed() / 1000);
 }
 
 void ZenBookmarkRunner::run(const RunnerContext & /*context*/, const QueryMatch &match)
 {
-    const QMap<QString, QVariant> data = match.data().toMap();
-    QString url = data.value("url").toString();
-    
-    // Launch Zen browser with the bookmark URL using flatpak
-    QStringList args = {"run", "app.zen_browser.zen", url};
-    QProcess::startDetached("flatpak", args);
+    const QStringList urls = MatchPayload::urls(match.data(), indexUpdater.acquire().get());
+    if (urls.isEmpty()) {
+        qDebug() << "Bookmark of the match is no longer indexed";
+        return;
+    }
+
+    // A folder is opened with one browser process
+    if (launcher.openUrls(urls)) {
+        QMutexLocker locker(&launchCountsMutex);
+        for (const QString &url : urls) {
+            ++launchCounts[url];
+        }
+    }
 }
 
-QueryMatch ZenBookmarkRunner::createMatch(const QString &text, const QMap<QString, QVariant> &data, float relevance)
+QueryMatch ZenBookmarkRunner::createMatch(const QString &text, const QVariant &data, float relevance, const QIcon &icon)
 {
     QueryMatch match(this);
-    
+
     // Use favicon if available, otherwise use default icon
-    if (data.contains("favicon") && !data.value("favicon").toString().isEmpty()) {
-        QString faviconPath = data.value("favicon").toString();
-        qDebug() << "Setting favicon icon from path:" << faviconPath;
-        QIcon faviconIcon(faviconPath);
-        if (faviconIcon.isNull()) {
-            qDebug() << "Failed to load favicon icon, using default";
-            match.setIconName(zenIcon);
-        } else {
-            qDebug() << "Successfully loaded favicon icon";
-            match.setIcon(faviconIcon);
-        }
-    } else {
-        qDebug() << "No favicon data in match, using default icon";
+    if (icon.isNull()) {
         match.setIconName(zenIcon);
+    } else {
+        match.setIcon(icon);
     }
-    
+
     match.setText(text);
     match.setData(data);
     match.setRelevance(relevance);
@@ -100,274 +200,224 @@ QueryMatch ZenBookmarkRunner::createMatch(const QString &text, const QMap<QStrin
     return match;
 }
 
+/**
+ * Statistics for the D-Bus interface, called on the main thread
+ */
+QVariantMap ZenBookmarkRunner::collectStats()
+{
+    QVariantMap stats;
+    if (const auto snapshot = indexUpdater.acquire()) {
+        const IndexMemoryUsage memory = snapshot->memoryUsage();
+        stats.insert(QStringLiteral("indexGeneration"), snapshot->generation);
+        stats.insert(QStringLiteral("indexEntries"), snapshot->size());
+        stats.insert(QStringLiteral("indexUrlTokens"), snapshot->tokenCount());
+        stats.insert(QStringLiteral("memoryStringsBytes"), memory.strings);
+        stats.insert(QStringLiteral("memoryUrlTokensBytes"), memory.urlTokens);
+        stats.insert(QStringLiteral("memoryLookupsBytes"), memory.lookups);
+        stats.insert(QStringLiteral("memoryWordStartsBytes"), memory.wordStarts);
+    } else {
+        stats.insert(QStringLiteral("indexEntries"), 0);
+    }
+    stats.insert(QStringLiteral("indexPatches"), indexUpdater.patches());
+    stats.insert(QStringLiteral("indexRebuilds"), indexUpdater.rebuilds());
+    const PlacesReader::BuildStats build = indexUpdater.lastBuild();
+    stats.insert(QStringLiteral("indexBuildUs"), build.totalUs);
+    stats.insert(QStringLiteral("indexBuildReadUs"), build.readUs);
+    stats.insert(QStringLiteral("indexBuildPrepareUs"), build.prepareUs);
+    stats.insert(QStringLiteral("indexBuildInsertUs"), build.insertUs);
+    stats.insert(QStringLiteral("daemonQueries"), indexClient.queries());
+    stats.insert(QStringLiteral("daemonFailures"), indexClient.failures());
+
+    const QueryArena::Stats arena = QueryArena::stats();
+    stats.insert(QStringLiteral("arenaHighWaterBytes"), arena.highWaterBytes);
+    stats.insert(QStringLiteral("arenaCapacityBytes"), arena.capacityBytes);
+    stats.insert(QStringLiteral("arenaOverflows"), arena.overflows);
+
+    const PlacesDatabase::Stats snapshots = PlacesDatabase::stats();
+    stats.insert(QStringLiteral("snapshotCount"), snapshots.snapshots);
+    stats.insert(QStringLiteral("snapshotReuses"), snapshots.reuses);
+    stats.insert(QStringLiteral("snapshotBytesCloned"), snapshots.bytesCloned);
+    stats.insert(QStringLiteral("snapshotBytesCopied"), snapshots.bytesCopied);
+    stats.insert(QStringLiteral("snapshotLastBytesCopied"), snapshots.lastBytesCopied);
+
+    stats.insert(QStringLiteral("memoryIconCacheBytes"), faviconCache.memoryUsage());
+    stats.insert(QStringLiteral("iconCount"), faviconCache.iconCount());
+    const quint64 iconHits = faviconCache.hits();
+    const quint64 iconLookups = iconHits + faviconCache.misses();
+    stats.insert(QStringLiteral("iconCacheHits"), iconHits);
+    stats.insert(QStringLiteral("iconCacheHitRate"), iconLookups == 0 ? 0.0 : double(iconHits) / iconLookups);
+    const quint64 tabHits = openTabs.hits();
+    const quint64 tabLookups = tabHits + openTabs.reads();
+    stats.insert(QStringLiteral("sessionCacheHitRate"), tabLookups == 0 ? 0.0 : double(tabHits) / tabLookups);
+
+    const BrowserLauncher::LaunchCommand command = launcher.command();
+    const BrowserLauncher::LaunchStats launches = launcher.stats(command.backend);
+    stats.insert(QStringLiteral("launchBackend"), BrowserLauncher::backendName(command.backend));
+    stats.insert(QStringLiteral("launches"), launches.launches);
+    stats.insert(QStringLiteral("launchFailures"), launches.failures);
+    stats.insert(QStringLiteral("launchLastUs"), launches.lastNs / 1000);
+    return stats;
+}
+
+/**
+ * Resolve the favicons of the most launched and most frecent bookmarks in the background
+ */
+void ZenBookmarkRunner::prefetchFavicons(const BookmarkIndex &index)
+{
+    if (!QFile::exists(zenFaviconsPath)) {
+        return;
+    }
+    QHash<QString, int> launches;
+    {
+        QMutexLocker locker(&launchCountsMutex);
+        launches = launchCounts;
+    }
+    QVector<const Bookmark *> candidates;
+    candidates.reserve(index.size());
+    for (const Bookmark &bookmark : index.bookmarks()) {
+        candidates.append(&bookmark);
+    }
+    const int count = std::min<int>(candidates.size(), faviconPrefetcher.maxIcons);
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), [&launches](const Bookmark *a, const Bookmark *b) {
+        const int launchesA = launches.value(a->url);
+        const int launchesB = launches.value(b->url);
+        return launchesA != launchesB ? launchesA > launchesB : a->frecency > b->frecency;
+    });
+    QStringList urls;
+    urls.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        urls.append(candidates.at(i)->url);
+    }
+    faviconPrefetcher.schedule(zenFaviconsPath, urls);
+}
+
+/**
+ * Resolve the icons a query did not find in the cache, a newer query cancels the previous one
+ */
+void ZenBookmarkRunner::prefetchUncachedFavicons(const QStringList &urls)
+{
+    if (!urls.isEmpty() && QFile::exists(zenFaviconsPath)) {
+        faviconPrefetcher.schedule(zenFaviconsPath, urls);
+    }
+}
+
 QList<QueryMatch> ZenBookmarkRunner::createBookmarkMatches(const QString &filter)
 {
     QList<::QueryMatch> matches;
-    
+
     // Check if places.sqlite exists
-    qDebug() << "Looking for database at:" << zenBookmarksPath;
     if (!QFile::exists(zenBookmarksPath)) {
         qDebug() << "Zen bookmarks database not found at:" << zenBookmarksPath;
         return matches;
     }
-    qDebug() << "Database file exists";
-    
-    // Create a unique connection name to avoid conflicts
-    QString connectionName = QString("zen_bookmarks_%1").arg(reinterpret_cast<qintptr>(QThread::currentThread()));
-    
-    // Always use a temporary copy to avoid locking issues
-    qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
-    QString tempDbPath = QDir::temp().filePath(QString("zen_bookmarks_%1.db").arg(timestamp));
-    QString tempFaviconsPath = QDir::temp().filePath(QString("zen_favicons_%1.db").arg(timestamp));
-    
-    // Copy the main database file
-    if (!QFile::copy(zenBookmarksPath, tempDbPath)) {
-        qDebug() << "Failed to copy database to temp location";
-        return matches;
-    }
-    
-    // Copy the favicons database file
-    bool hasFavicons = false;
-    if (QFile::exists(zenFaviconsPath) && QFile::copy(zenFaviconsPath, tempFaviconsPath)) {
-        hasFavicons = true;
-        qDebug() << "Copied favicons database";
-        
-        // Also copy WAL and SHM files for favicons if they exist
-        QString faviconWalPath = zenFaviconsPath + "-wal";
-        QString tempFaviconWalPath = tempFaviconsPath + "-wal";
-        if (QFile::exists(faviconWalPath)) {
-            QFile::copy(faviconWalPath, tempFaviconWalPath);
-        }
-        
-        QString faviconShmPath = zenFaviconsPath + "-shm";
-        QString tempFaviconShmPath = tempFaviconsPath + "-shm";
-        if (QFile::exists(faviconShmPath)) {
-            QFile::copy(faviconShmPath, tempFaviconShmPath);
+
+    FaviconPrefetcher::QueryGuard prefetchGuard(faviconPrefetcher);
+    if (useIndexDaemon) {
+        IndexProtocol::Response response;
+        if (indexClient.query(filter, MaxBookmarkMatches, response)) {
+            return createDaemonMatches(response);
         }
     }
-    
-    // Also copy WAL file if it exists (this contains recent changes)
-    QString walPath = zenBookmarksPath + "-wal";
-    QString tempWalPath = tempDbPath + "-wal";
-    if (QFile::exists(walPath)) {
-        QFile::copy(walPath, tempWalPath);
-        qDebug() << "Copied WAL file";
-    }
-    
-    // Also copy SHM file if it exists
-    QString shmPath = zenBookmarksPath + "-shm";
-    QString tempShmPath = tempDbPath + "-shm";
-    if (QFile::exists(shmPath)) {
-        QFile::copy(shmPath, tempShmPath);
-        qDebug() << "Copied SHM file";
-    }
-    
-    QSqlDatabase db;
-    if (QSqlDatabase::contains(connectionName)) {
-        db = QSqlDatabase::database(connectionName);
-    } else {
-        db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+
+    indexUpdater.scheduleRefresh();
+    // Keeps this generation alive until the matches are created, even if a refresh publishes a new one
+    const auto snapshot = indexUpdater.acquire();
+    if (!snapshot) {
+        return matches;
     }
-    
-    db.setDatabaseName(tempDbPath);
-    
-    if (!db.open()) {
-        qDebug() << "Failed to open temp database:" << db.lastError().text();
-        QFile::remove(tempDbPath);
-        QFile::remove(tempWalPath);
-        QFile::remove(tempShmPath);
-        QSqlDatabase::removeDatabase(connectionName);
+
+    // A keyword shortcut is what the user asked for, skip the search
+    QString keywordUrl;
+    if (const BookmarkKeyword *keyword = BookmarkSearch::resolveKeyword(*snapshot, filter, keywordUrl)) {
+        QIcon icon;
+        faviconCache.cachedIcon(keyword->url, icon);
+        const QString title = keyword->title.isEmpty() ? keyword->keyword : keyword->title;
+        matches.append(createMatch(title + " - " + keywordUrl, MatchPayload::forUrl(keywordUrl), 1.0, icon));
         return matches;
     }
-    
-    qDebug() << "Using temporary database copy at:" << tempDbPath;
-    
-    QString queryStr = "SELECT moz_bookmarks.title, moz_places.url FROM moz_bookmarks "
-                      "JOIN moz_places ON moz_bookmarks.fk = moz_places.id "
-                      "WHERE moz_bookmarks.title IS NOT NULL AND moz_bookmarks.title != '' ";
-    
-    if (!filter.isEmpty()) {
-        queryStr += "AND (moz_bookmarks.title LIKE ? OR moz_places.url LIKE ?)";
+
+    const BookmarkQuery query = BookmarkQuery::parse(filter);
+    for (const FolderResult &folder : BookmarkSearch::folderSearch(*snapshot, query, MaxFolderMatches)) {
+        matches.append(createMatch(folder.text(), MatchPayload::forUrls(folder.urls()), folder.relevance, QIcon::fromTheme(folderIconName)));
     }
-    
-    queryStr += " ORDER BY moz_bookmarks.title";
-    
-    QSqlQuery query(db);
-    query.prepare(queryStr);
-    
-    if (!filter.isEmpty()) {
-        QString likeFilter = "%" + filter + "%";
-        query.addBindValue(likeFilter);
-        query.addBindValue(likeFilter);
+
+    BookmarkSearch::Results results(QueryArena::resource());
+    BookmarkSearch::search(*snapshot, query, results, MaxBookmarkMatches);
+    if (results.empty()) {
+        return matches;
     }
-    
-    qDebug() << "Executing query:" << queryStr;
-    qDebug() << "Filter:" << filter;
-    
-    if (query.exec()) {
-        qDebug() << "Query executed successfully";
-        int count = 0;
-        while (query.next()) {
-            count++;
-            QString title = query.value(0).toString();
-            QString url = query.value(1).toString();
-            
-            if (title.isEmpty() || url.isEmpty()) {
-                continue;
-            }
-            
-            QMap<QString, QVariant> data;
-            data.insert("url", url);
-            
-            // Get favicon for this URL
-            QString faviconPath;
-            if (hasFavicons) {
-                qDebug() << "Trying to get favicon for URL:" << url;
-                faviconPath = getFaviconForUrl(url, tempFaviconsPath);
-                if (!faviconPath.isEmpty()) {
-                    qDebug() << "Got favicon path:" << faviconPath;
-                    data.insert("favicon", faviconPath);
-                } else {
-                    qDebug() << "No favicon found for URL:" << url;
-                }
-            } else {
-                qDebug() << "No favicons database available";
-            }
-            
-            QString displayText = title;
-            if (!url.isEmpty()) {
-                displayText += " - " + url;
-            }
-            
-            float relevance = 0.8;
-            if (!filter.isEmpty()) {
-                if (title.contains(filter, Qt::CaseInsensitive)) {
-                    relevance = 0.9;
-                }
-                if (title.startsWith(filter, Qt::CaseInsensitive)) {
-                    relevance = 1.0;
-                }
-            }
-            
-            matches.append(createMatch(displayText, data, relevance));
+
+    // Copying favicons.sqlite would take longer than the whole query, icons that were not looked up yet are
+    // left to the prefetch and shown by the next keystrokes
+    QStringList uncachedUrls;
+    matches.reserve(matches.size() + results.size());
+    for (const SearchResult &result : results) {
+        const Bookmark *bookmark = result.bookmark;
+        QIcon icon;
+        if (!faviconCache.cachedIcon(bookmark->url, icon)) {
+            uncachedUrls.append(bookmark->url);
         }
-        qDebug() << "Found" << count << "bookmarks";
-    } else {
-        qDebug() << "Failed to execute bookmark query:" << query.lastError().text();
-        qDebug() << "Query was:" << queryStr;
-    }
-    
-    // Clean up
-    QString dbName = db.databaseName();
-    db.close();
-    QSqlDatabase::removeDatabase(connectionName);
-    
-    // Remove temp files
-    QFile::remove(dbName);
-    QFile::remove(dbName + "-wal");
-    QFile::remove(dbName + "-shm");
-    
-    // Remove favicon temp files
-    if (hasFavicons) {
-        QFile::remove(tempFaviconsPath);
-        QFile::remove(tempFaviconsPath + "-wal");
-        QFile::remove(tempFaviconsPath + "-shm");
+        matches.append(createMatch(bookmark->displayText, MatchPayload::forBookmark(*bookmark), result.relevance, icon));
     }
-    
+    prefetchUncachedFavicons(uncachedUrls);
+    qDebug() << "Found" << matches.size() << "bookmarks";
     return matches;
 }
 
-QString ZenBookmarkRunner::getFaviconForUrl(const QString &url, const QString &tempFaviconsDbPath)
+/**
+ * Matches for the results of zen-bookmark-daemon. They carry the URL, the bookmark ids of the daemon
+ * are not known to this process. Icons are taken from the cache like for the own index, which is not
+ * loaded in this mode, so the results are the only source of URLs to prefetch.
+ */
+QList<QueryMatch> ZenBookmarkRunner::createDaemonMatches(const IndexProtocol::Response &response)
 {
-    // Use a unique connection name for each call to avoid conflicts
-    QString faviconConnectionName = QString("zen_favicons_%1_%2").arg(reinterpret_cast<qintptr>(QThread::currentThread())).arg(QDateTime::currentMSecsSinceEpoch());
-    
-    QSqlDatabase faviconDb = QSqlDatabase::addDatabase("QSQLITE", faviconConnectionName);
-    faviconDb.setDatabaseName(tempFaviconsDbPath);
-    
-    if (!faviconDb.open()) {
-        qDebug() << "Failed to open favicons database:" << faviconDb.lastError().text();
-        return QString();
-    }
-    
-    qDebug() << "Opened favicons database successfully";
-    
-    // Firefox favicon structure: moz_pages_w_icons -> moz_icons_to_pages -> moz_icons
-    // Query to get favicon data for a specific URL
-    QString queryStr = "SELECT i.data FROM moz_icons i "
-                      "JOIN moz_icons_to_pages itp ON i.id = itp.icon_id "
-                      "JOIN moz_pages_w_icons p ON itp.page_id = p.id "
-                      "WHERE p.page_url = ? AND i.data IS NOT NULL "
-                      "ORDER BY i.width DESC LIMIT 1";
-    
-    QSqlQuery faviconQuery(faviconDb);
-    faviconQuery.prepare(queryStr);
-    faviconQuery.addBindValue(url);
-    
-    qDebug() << "Executing favicon query for URL:" << url;
-    
-    if (faviconQuery.exec()) {
-        qDebug() << "Favicon query executed successfully";
-        if (faviconQuery.next()) {
-            qDebug() << "Found favicon data for URL:" << url;
-            QByteArray iconData = faviconQuery.value(0).toByteArray();
-        if (!iconData.isEmpty()) {
-            // Save icon data to a temporary file
-            QString tempIconPath = QDir::temp().filePath(QString("zen_favicon_%1_%2.ico")
-                                                        .arg(QDateTime::currentMSecsSinceEpoch())
-                                                        .arg(qHash(url)));
-            QFile iconFile(tempIconPath);
-            if (iconFile.open(QIODevice::WriteOnly)) {
-                iconFile.write(iconData);
-                iconFile.close();
-                qDebug() << "Created favicon file:" << tempIconPath;
-                faviconDb.close();
-                QSqlDatabase::removeDatabase(faviconConnectionName);
-                return tempIconPath;
-            }
+    QList<QueryMatch> matches;
+    QStringList uncachedUrls;
+    matches.reserve(response.results.size());
+    for (const IndexProtocol::Result &result : response.results) {
+        if (result.kind == IndexProtocol::ResultKind::Folder) {
+            matches.append(createMatch(result.text, MatchPayload::forUrls(result.urls), result.relevance, QIcon::fromTheme(folderIconName)));
+            continue;
         }
-        } else {
-            qDebug() << "No favicon data found for exact URL:" << url;
+        QIcon icon;
+        if (!faviconCache.cachedIcon(result.url, icon)) {
+            uncachedUrls.append(result.url);
         }
-    } else {
-        qDebug() << "Favicon query failed:" << faviconQuery.lastError().text();
-        // Try fallback query with host matching
-        QUrl parsedUrl(url);
-        QString host = parsedUrl.host();
-        if (!host.isEmpty()) {
-            QString fallbackQuery = "SELECT i.data FROM moz_icons i "
-                                   "JOIN moz_icons_to_pages itp ON i.id = itp.icon_id "
-                                   "JOIN moz_pages_w_icons p ON itp.page_id = p.id "
-                                   "WHERE p.page_url LIKE ? AND i.data IS NOT NULL "
-                                   "ORDER BY i.width DESC LIMIT 1";
-            
-            QSqlQuery fallbackFaviconQuery(faviconDb);
-            fallbackFaviconQuery.prepare(fallbackQuery);
-            fallbackFaviconQuery.addBindValue("%" + host + "%");
-            
-            if (fallbackFaviconQuery.exec() && fallbackFaviconQuery.next()) {
-                QByteArray iconData = fallbackFaviconQuery.value(0).toByteArray();
-                if (!iconData.isEmpty()) {
-                    QString tempIconPath = QDir::temp().filePath(QString("zen_favicon_%1_%2.ico")
-                                                                .arg(QDateTime::currentMSecsSinceEpoch())
-                                                                .arg(qHash(url)));
-                    QFile iconFile(tempIconPath);
-                    if (iconFile.open(QIODevice::WriteOnly)) {
-                        iconFile.write(iconData);
-                        iconFile.close();
-                        qDebug() << "Created fallback favicon file:" << tempIconPath;
-                        faviconDb.close();
-                        QSqlDatabase::removeDatabase(faviconConnectionName);
-                        return tempIconPath;
-                    }
-                }
-            }
+        matches.append(createMatch(result.text, MatchPayload::forUrl(result.url), result.relevance, icon));
+    }
+    prefetchUncachedFavicons(uncachedUrls);
+    qDebug() << "Found" << matches.size() << "bookmarks in generation" << response.generation << "of the daemon";
+    return matches;
+}
+
+/**
+ * Search the tabs of the session store, the matches carry the URL and are opened by run()
+ */
+QList<QueryMatch> ZenBookmarkRunner::createTabMatches(const QString &filter)
+{
+    QList<QueryMatch> matches;
+    if (!QFile::exists(zenSessionPath)) {
+        qDebug() << "Zen session store not found at:" << zenSessionPath;
+        return matches;
+    }
+
+    const auto tabs = openTabs.tabs(zenSessionPath);
+    const QVector<TabResult> results = OpenTabs::search(*tabs, filter);
+    matches.reserve(results.size());
+    for (const TabResult &result : results) {
+        const OpenTab *tab = result.tab;
+
+        // Tabs are not prefetched, only use icons that are already decoded
+        QIcon icon;
+        faviconCache.cachedIcon(tab->url, icon);
+        QueryMatch match = createMatch(tab->displayText, MatchPayload::forUrl(tab->url), result.relevance, icon);
+        if (!tab->workspace.isEmpty()) {
+            match.setSubtext(tab->workspace);
         }
+        matches.append(match);
     }
-    
-    faviconDb.close();
-    QSqlDatabase::removeDatabase(faviconConnectionName);
-    return QString();
+    qDebug() << "Found" << matches.size() << "tabs";
+    return matches;
 }
 
 K_PLUGIN_CLASS_WITH_JSON(ZenBookmarkRunner, "firefoxprofilerunner.json")
@@ -1,17 +1,22 @@
 #pragma once
 
+#include "bookmarks/BookmarkIndex.h"
+#include "bookmarks/BookmarkSearch.h"
+#include "bookmarks/IndexUpdater.h"
+#include "dbus/StatsService.h"
+#include "favicons/FaviconCache.h"
+#include "favicons/FaviconPrefetcher.h"
+#include "launcher/BrowserLauncher.h"
+#include "service/IndexClient.h"
+#include "tabs/OpenTabs.h"
 // Removed profile includes as not needed for zen-bookmark
 #include <KRunner/AbstractRunner>
 // Removed QFileSystemWatcher as not needed
-#include <QRegularExpression>
+#include <QMutex>
 #include <QString>
+#include <QTimer>
 #include <krunner_version.h>
 
-struct Bookmark {
-    QString title;
-    QString url;
-};
-
 #if KRUNNER_VERSION_MAJOR == 5
 using namespace Plasma;
 #include <QAction>
@@ -27,20 +32,54 @@ class ZenBookmarkRunner : public AbstractRunner
 public:
     ZenBookmarkRunner(QObject *parent, const KPluginMetaData &data, const QVariantList &args);
 
-    // NOTE: Prefixes need to be included in filterRegex.
-    QLatin1String shortPrefix = QLatin1String("b");
-    QLatin1String mediumPrefix = QLatin1String("bookmark");
-    const QRegularExpression filterRegex = QRegularExpression(R"(^(?:b|bookmark\w*)(?: (.+))$)", QRegularExpression::CaseInsensitiveOption);
-    // Removed private window flag regex as not needed for bookmarks
-
+    // NOTE: The trigger words are parsed by BookmarkSearch::parseQuery
     QString zenBookmarksPath;
     QString zenFaviconsPath;
+    QString zenSessionPath;
     QString zenIcon;
+    BrowserLauncher launcher;
+
+    // Searched by a running zen-bookmark-daemon instead of the own index if enabled, see Config::UseIndexDaemon
+    bool useIndexDaemon = false;
+    IndexClient indexClient;
+
+    // Creating more matches than KRunner shows only costs icon lookups
+    static constexpr int MaxBookmarkMatches = BookmarkSearch::MatchLimit;
+    static constexpr int MaxFolderMatches = BookmarkSearch::FolderMatchLimit;
+    // Logical size of the match icons in the KRunner list
+    static constexpr int FaviconDisplaySize = 32;
+    FaviconCache faviconCache;
+    FaviconPrefetcher faviconPrefetcher{faviconCache};
+    // Launches per URL during this session, used to prioritize the favicon prefetch
+    QMutex launchCountsMutex;
+    QHash<QString, int> launchCounts;
+    // Decompressed session store, shared by the queries until Zen writes it again
+    OpenTabs openTabs;
 // Removed matchActions as not needed for zen-bookmark
 
+    // org.kde.zenbookmark /ZenBookmark on the session bus
+    StatsService statsService;
+
+    // Caches are released when KRunner was not opened for this time
+    int idleEvictionSeconds = 0;
+    QTimer *idleTimer = nullptr;
+
+    void warmUp();
+    void releaseCaches();
+    // Block until index refreshes and the favicon prefetch they started are done
+    void waitForBackgroundWork();
+    QVariantMap collectStats();
+    void prefetchFavicons(const BookmarkIndex &index);
+    void prefetchUncachedFavicons(const QStringList &urls);
     QList<QueryMatch> createBookmarkMatches(const QString &filter);
-    QueryMatch createMatch(const QString &text, const QMap<QString, QVariant> &data, float relevance);
-    QString getFaviconForUrl(const QString &url, const QString &tempFaviconsDbPath);
+    QList<QueryMatch> createDaemonMatches(const IndexProtocol::Response &response);
+    QList<QueryMatch> createTabMatches(const QString &filter);
+    QueryMatch createMatch(const QString &text, const QVariant &data, float relevance, const QIcon &icon);
+
+private:
+    // match() is called from multiple threads, it reads the published generation without locking.
+    // Declared last so that it is destroyed first and waits for a running refresh.
+    IndexUpdater indexUpdater;
 
 public: // AbstractRunner API
     void reloadConfiguration() override;
@@ -0,0 +1,176 @@
+#include "BrowserLauncher.h"
+
+#include "firefox_debug.h"
+#include <KConfigGroup>
+#include <KSharedConfig>
+#include <KShell>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QProcess>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+/**
+ * Start the browser with the given URL. If Zen is already running the browser itself forwards
+ * the URL to the existing instance, so the cost we control is only the process we spawn.
+ */
+bool BrowserLauncher::openUrl(const QString &url)
+{
+    return openUrls(QStringList{url});
+}
+
+/**
+ * Zen opens every URL argument in its own tab. Spawning flatpak once per URL would set up the sandbox
+ * each time, with all URLs in one command line that is paid once.
+ */
+bool BrowserLauncher::openUrls(const QStringList &urls)
+{
+    if (urls.isEmpty()) {
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    const LaunchCommand cmd = command();
+    if (cmd.backend == Backend::None) {
+        qCWarning(FIREFOX) << "Can not find a Zen installation to open" << urls;
+        return false;
+    }
+    const bool success = QProcess::startDetached(cmd.program, cmd.arguments + urls);
+    const qint64 elapsed = timer.nsecsElapsed();
+    recordLaunch(cmd.backend, elapsed, success);
+    qCDebug(FIREFOX) << "Launched" << urls.size() << "URLs using" << backendName(cmd.backend) << "in" << elapsed / 1000 << "us";
+    if (!success) {
+        // The cached command may be stale, e.g. Zen was uninstalled or switched to flatpak
+        invalidate();
+    }
+    return success;
+}
+
+/**
+ * Get the cached launch command, resolving it on first use
+ */
+BrowserLauncher::LaunchCommand BrowserLauncher::command()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_resolved) {
+        m_command = resolve();
+        m_resolved = true;
+        qCDebug(FIREFOX) << "Resolved Zen launch command" << backendName(m_command.backend) << m_command.program << m_command.arguments;
+    }
+    return m_command;
+}
+
+BrowserLauncher::LaunchStats BrowserLauncher::stats(Backend backend) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats[static_cast<int>(backend)];
+}
+
+void BrowserLauncher::invalidate()
+{
+    QMutexLocker locker(&m_mutex);
+    m_resolved = false;
+}
+
+QString BrowserLauncher::backendName(Backend backend)
+{
+    switch (backend) {
+    case Backend::Native:
+        return QStringLiteral("native");
+    case Backend::Flatpak:
+        return QStringLiteral("flatpak");
+    case Backend::DesktopFile:
+        return QStringLiteral("desktop-file");
+    case Backend::None:
+        break;
+    }
+    return QStringLiteral("none");
+}
+
+/**
+ * Get launch command from the Exec key of a .desktop file, field codes and flatpak file forwarding
+ * markers are removed because we pass the URL as a plain argument
+ */
+BrowserLauncher::LaunchCommand BrowserLauncher::commandFromDesktopFile(const QString &desktopFile)
+{
+    LaunchCommand cmd;
+    const QString exec = KSharedConfig::openConfig(desktopFile, KConfig::SimpleConfig)->group("Desktop Entry").readEntry("Exec");
+    QStringList args = KShell::splitArgs(exec);
+    if (args.isEmpty()) {
+        return cmd;
+    }
+    args.erase(std::remove_if(args.begin(),
+                              args.end(),
+                              [](const QString &arg) {
+                                  return arg.startsWith(QLatin1Char('%')) || arg.startsWith(QLatin1String("@@"))
+                                      || arg == QLatin1String("--file-forwarding");
+                              }),
+               args.end());
+    const QString program = QStandardPaths::findExecutable(args.takeFirst());
+    if (program.isEmpty()) {
+        return cmd;
+    }
+    cmd.backend = QFileInfo(program).fileName() == QLatin1String("flatpak") ? Backend::Flatpak : Backend::DesktopFile;
+    cmd.program = program;
+    cmd.arguments = args;
+    return cmd;
+}
+
+/**
+ * Check the installation types from cheapest to most expensive: a native binary is executed directly,
+ * a .desktop file may point to a custom wrapper (AppImage, script) and flatpak has to set up the sandbox.
+ */
+BrowserLauncher::LaunchCommand BrowserLauncher::resolve() const
+{
+    LaunchCommand cmd;
+    for (const QString &name : zenExecutableNames) {
+        if (const QString program = QStandardPaths::findExecutable(name); !program.isEmpty()) {
+            cmd.backend = Backend::Native;
+            cmd.program = program;
+            return cmd;
+        }
+    }
+
+    for (const QString &name : zenDesktopNames) {
+        const QString desktopFile = QStandardPaths::locate(QStandardPaths::ApplicationsLocation, name);
+        if (desktopFile.isEmpty()) {
+            continue;
+        }
+        cmd = commandFromDesktopFile(desktopFile);
+        if (cmd.backend != Backend::None) {
+            return cmd;
+        }
+    }
+
+    const QString flatpak = QStandardPaths::findExecutable(QStringLiteral("flatpak"));
+    const QStringList flatpakInstallations{
+        QDir::homePath() + "/.local/share/flatpak/app/" + flatpakAppId,
+        "/var/lib/flatpak/app/" + flatpakAppId,
+    };
+    for (const QString &installation : flatpakInstallations) {
+        if (!flatpak.isEmpty() && QFileInfo::exists(installation)) {
+            cmd.backend = Backend::Flatpak;
+            cmd.program = flatpak;
+            cmd.arguments = QStringList{QStringLiteral("run"), flatpakAppId};
+            return cmd;
+        }
+    }
+    return LaunchCommand{};
+}
+
+void BrowserLauncher::recordLaunch(Backend backend, qint64 elapsedNs, bool success)
+{
+    QMutexLocker locker(&m_mutex);
+    LaunchStats &stats = m_stats[static_cast<int>(backend)];
+    if (!success) {
+        ++stats.failures;
+        return;
+    }
+    ++stats.launches;
+    stats.lastNs = elapsedNs;
+    stats.totalNs += elapsedNs;
+    stats.maxNs = std::max(stats.maxNs, elapsedNs);
+}
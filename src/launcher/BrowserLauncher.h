@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Resolves how Zen is installed once and hands URLs to it using the cheapest available command.
+ * The resolved command is cached until invalidate() is called, so run() does not search PATH,
+ * parse .desktop files or query flatpak on every launch.
+ */
+class BrowserLauncher
+{
+public:
+    enum class Backend {
+        None,
+        Native,
+        Flatpak,
+        DesktopFile,
+    };
+
+    struct LaunchCommand {
+        Backend backend = Backend::None;
+        QString program;
+        QStringList arguments;
+    };
+
+    struct LaunchStats {
+        int launches = 0;
+        int failures = 0;
+        qint64 lastNs = 0;
+        qint64 totalNs = 0;
+        qint64 maxNs = 0;
+    };
+
+    bool openUrl(const QString &url);
+    /**
+     * Open all URLs with a single process, e.g. the bookmarks of a folder
+     */
+    bool openUrls(const QStringList &urls);
+
+    LaunchCommand command();
+    LaunchStats stats(Backend backend) const;
+    void invalidate();
+
+    static QString backendName(Backend backend);
+    static LaunchCommand commandFromDesktopFile(const QString &desktopFile);
+
+    QString flatpakAppId = QStringLiteral("app.zen_browser.zen");
+
+private:
+    LaunchCommand resolve() const;
+    void recordLaunch(Backend backend, qint64 elapsedNs, bool success);
+
+    mutable QMutex m_mutex;
+    bool m_resolved = false;
+    LaunchCommand m_command;
+    LaunchStats m_stats[4];
+
+    const QStringList zenExecutableNames{
+        QStringLiteral("zen"),
+        QStringLiteral("zen-browser"),
+    };
+    const QStringList zenDesktopNames{
+        QStringLiteral("zen.desktop"),
+        QStringLiteral("zen-browser.desktop"),
+        QStringLiteral("app.zen_browser.zen.desktop"),
+    };
+};
@@ -0,0 +1,57 @@
+#include "IndexClient.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QLocalSocket>
+
+bool IndexClient::query(const QString &filter, int limit, IndexProtocol::Response &response)
+{
+    if (QDateTime::currentMSecsSinceEpoch() < m_retryAfter.load()) {
+        return false;
+    }
+    ++m_queries;
+    QElapsedTimer timer;
+    timer.start();
+    QLocalSocket socket;
+    socket.connectToServer(m_socketPath);
+    if (!socket.waitForConnected(TimeoutMs)) {
+        return fail();
+    }
+    socket.write(IndexProtocol::encodeRequest(IndexProtocol::Request{IndexProtocol::RequestType::Query, limit, filter}));
+    if (!socket.waitForBytesWritten(TimeoutMs)) {
+        return fail();
+    }
+
+    QByteArray buffer;
+    QByteArray payload;
+    bool malformed = false;
+    while (!IndexProtocol::takeFrame(buffer, payload, malformed)) {
+        const int remaining = TimeoutMs - int(timer.elapsed());
+        if (malformed || remaining <= 0 || !socket.waitForReadyRead(remaining)) {
+            return fail();
+        }
+        buffer.append(socket.readAll());
+    }
+    if (!IndexProtocol::decodeResponse(payload, response)) {
+        return fail();
+    }
+    // Not an error of the daemon, it loads the index in the background
+    return response.status == IndexProtocol::Status::Ok;
+}
+
+bool IndexClient::isAvailable()
+{
+    if (QDateTime::currentMSecsSinceEpoch() < m_retryAfter.load()) {
+        return false;
+    }
+    QLocalSocket socket;
+    socket.connectToServer(m_socketPath);
+    return socket.waitForConnected(TimeoutMs) || fail();
+}
+
+bool IndexClient::fail()
+{
+    ++m_failures;
+    m_retryAfter = QDateTime::currentMSecsSinceEpoch() + RetryIntervalMs;
+    return false;
+}
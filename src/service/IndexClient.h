@@ -0,0 +1,53 @@
+#pragma once
+
+#include "IndexProtocol.h"
+
+#include <QString>
+
+#include <atomic>
+
+/**
+ * Queries zen-bookmark-daemon from the runner. Every query uses its own blocking connection, so that it can be
+ * called from the match threads. After a failure the daemon is not asked again for RetryIntervalMs, the caller
+ * searches its own index meanwhile.
+ */
+class IndexClient
+{
+public:
+    // Connecting and a top 20 round trip take a fraction of a millisecond, this only guards against a hung daemon
+    static constexpr int TimeoutMs = 100;
+    static constexpr qint64 RetryIntervalMs = 10 * 1000;
+
+    explicit IndexClient(const QString &socketPath = IndexProtocol::defaultSocketPath())
+        : m_socketPath(socketPath)
+    {
+    }
+
+    /**
+     * Returns false if the daemon is not running, did not answer in time or has no index yet
+     */
+    bool query(const QString &filter, int limit, IndexProtocol::Response &response);
+
+    /**
+     * Whether the daemon accepts connections. A failure starts the retry interval like a failed query,
+     * during it the daemon is not asked.
+     */
+    bool isAvailable();
+
+    quint64 queries() const
+    {
+        return m_queries;
+    }
+    quint64 failures() const
+    {
+        return m_failures;
+    }
+
+private:
+    bool fail();
+
+    const QString m_socketPath;
+    std::atomic<qint64> m_retryAfter{0};
+    std::atomic<quint64> m_queries{0};
+    std::atomic<quint64> m_failures{0};
+};
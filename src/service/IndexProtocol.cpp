@@ -0,0 +1,259 @@
+#include "IndexProtocol.h"
+
+#include <QStandardPaths>
+#include <QtEndian>
+
+#include <cstring>
+#include <limits>
+
+namespace
+{
+class Writer
+{
+public:
+    Writer()
+    {
+        // Size of the frame, filled in by frame()
+        m_data.resize(IndexProtocol::FrameHeaderSize);
+    }
+
+    template<typename T>
+    void number(T value)
+    {
+        char bytes[sizeof(T)];
+        qToLittleEndian(value, bytes);
+        m_data.append(bytes, sizeof(T));
+    }
+
+    void real(float value)
+    {
+        quint32 bits;
+        static_assert(sizeof(bits) == sizeof(value));
+        std::memcpy(&bits, &value, sizeof(bits));
+        number(bits);
+    }
+
+    void string(const QString &text)
+    {
+        QByteArray utf8 = text.toUtf8();
+        if (utf8.size() > std::numeric_limits<quint16>::max()) {
+            // Only absurdly long titles, the cut may split a code point which the decoder replaces
+            utf8.truncate(std::numeric_limits<quint16>::max());
+        }
+        number(quint16(utf8.size()));
+        m_data.append(utf8);
+    }
+
+    /**
+     * Overwrite a number that was written before, e.g. a count that is only known at the end
+     */
+    template<typename T>
+    void numberAt(qsizetype pos, T value)
+    {
+        qToLittleEndian(value, m_data.data() + pos);
+    }
+
+    qsizetype size() const
+    {
+        return m_data.size();
+    }
+    void truncate(qsizetype size)
+    {
+        m_data.truncate(size);
+    }
+
+    QByteArray frame()
+    {
+        qToLittleEndian(quint32(m_data.size() - IndexProtocol::FrameHeaderSize), m_data.data());
+        return m_data;
+    }
+
+private:
+    QByteArray m_data;
+};
+
+/**
+ * Bounds checked reads, a failed read makes every following one fail too
+ */
+class Reader
+{
+public:
+    explicit Reader(const QByteArray &data)
+        : m_pos(data.constData())
+        , m_end(data.constData() + data.size())
+    {
+    }
+
+    template<typename T>
+    T number()
+    {
+        if (!m_ok || m_end - m_pos < qsizetype(sizeof(T))) {
+            m_ok = false;
+            return T();
+        }
+        const T value = qFromLittleEndian<T>(m_pos);
+        m_pos += sizeof(T);
+        return value;
+    }
+
+    float real()
+    {
+        const quint32 bits = number<quint32>();
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    QString string()
+    {
+        const quint16 size = number<quint16>();
+        if (!m_ok || m_end - m_pos < size) {
+            m_ok = false;
+            return QString();
+        }
+        const QString text = QString::fromUtf8(m_pos, size);
+        m_pos += size;
+        return text;
+    }
+
+    bool atEnd() const
+    {
+        return m_ok && m_pos == m_end;
+    }
+    bool ok() const
+    {
+        return m_ok;
+    }
+
+private:
+    const char *m_pos;
+    const char *const m_end;
+    bool m_ok = true;
+};
+}
+
+QByteArray IndexProtocol::encodeRequest(const Request &request)
+{
+    Writer writer;
+    writer.number(Version);
+    writer.number(quint8(request.type));
+    writer.number(quint16(qBound(0, request.limit, int(std::numeric_limits<quint16>::max()))));
+    writer.string(request.filter);
+    return writer.frame();
+}
+
+QByteArray IndexProtocol::encodeResponse(const Response &response)
+{
+    Writer writer;
+    writer.number(Version);
+    writer.number(quint8(response.status));
+    writer.number(quint64(response.generation));
+    const qsizetype countPos = writer.size();
+    writer.number(quint16(0));
+    quint16 count = 0;
+    for (const Result &result : response.results) {
+        if (count == std::numeric_limits<quint16>::max()) {
+            break;
+        }
+        const qsizetype resultPos = writer.size();
+        writer.number(quint8(result.kind));
+        writer.real(result.relevance);
+        writer.string(result.text);
+        if (result.kind == ResultKind::Folder) {
+            const int urlCount = std::min<int>(result.urls.size(), std::numeric_limits<quint16>::max());
+            writer.number(quint16(urlCount));
+            for (int i = 0; i < urlCount; ++i) {
+                writer.string(result.urls.at(i));
+            }
+        } else {
+            writer.number(quint16(1));
+            writer.string(result.url);
+        }
+        // The client would drop the whole frame as malformed, the last results are dropped instead
+        if (writer.size() - IndexProtocol::FrameHeaderSize > qsizetype(MaxPayloadSize)) {
+            writer.truncate(resultPos);
+            break;
+        }
+        ++count;
+    }
+    writer.numberAt(countPos, count);
+    return writer.frame();
+}
+
+bool IndexProtocol::decodeRequest(const QByteArray &payload, Request &request)
+{
+    Reader reader(payload);
+    if (reader.number<quint8>() != Version || reader.number<quint8>() != quint8(RequestType::Query)) {
+        return false;
+    }
+    request.type = RequestType::Query;
+    request.limit = reader.number<quint16>();
+    request.filter = reader.string();
+    return reader.atEnd();
+}
+
+bool IndexProtocol::decodeResponse(const QByteArray &payload, Response &response)
+{
+    Reader reader(payload);
+    if (reader.number<quint8>() != Version) {
+        return false;
+    }
+    const quint8 status = reader.number<quint8>();
+    if (status > quint8(Status::BadRequest)) {
+        return false;
+    }
+    response.status = Status(status);
+    response.generation = reader.number<quint64>();
+    const quint16 count = reader.number<quint16>();
+    response.results.clear();
+    // Each result takes at least 9 bytes, a broken count must not make us reserve much
+    response.results.reserve(std::min<int>(count, payload.size() / 9));
+    for (int i = 0; i < count && reader.ok(); ++i) {
+        Result result;
+        const quint8 kind = reader.number<quint8>();
+        if (kind > quint8(ResultKind::Folder)) {
+            return false;
+        }
+        result.kind = ResultKind(kind);
+        result.relevance = reader.real();
+        result.text = reader.string();
+        const quint16 urlCount = reader.number<quint16>();
+        if (result.kind == ResultKind::Folder) {
+            result.urls.reserve(std::min<int>(urlCount, payload.size() / 2));
+            for (int url = 0; url < urlCount && reader.ok(); ++url) {
+                result.urls.append(reader.string());
+            }
+        } else if (urlCount == 1) {
+            result.url = reader.string();
+        } else {
+            return false;
+        }
+        response.results.append(result);
+    }
+    return reader.atEnd();
+}
+
+bool IndexProtocol::takeFrame(QByteArray &buffer, QByteArray &payload, bool &malformed)
+{
+    malformed = false;
+    if (buffer.size() < FrameHeaderSize) {
+        return false;
+    }
+    const quint32 size = qFromLittleEndian<quint32>(buffer.constData());
+    if (size > MaxPayloadSize) {
+        malformed = true;
+        return false;
+    }
+    if (buffer.size() - FrameHeaderSize < qsizetype(size)) {
+        return false;
+    }
+    payload = buffer.mid(FrameHeaderSize, size);
+    buffer.remove(0, FrameHeaderSize + size);
+    return true;
+}
+
+QString IndexProtocol::defaultSocketPath()
+{
+    const QString runtime = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    return (runtime.isEmpty() ? QStandardPaths::writableLocation(QStandardPaths::TempLocation) : runtime) + QStringLiteral("/zen-bookmark.sock");
+}
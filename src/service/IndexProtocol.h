@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * Messages between zen-bookmark-daemon and its clients on the Unix socket. Every message is a frame of a
+ * 32 bit little endian payload size and the payload. Numbers are little endian, strings are UTF-8 with a
+ * 16 bit size, floats are sent as their IEEE 754 bits.
+ *
+ * Request:  version u8, type u8, limit u16, filter string
+ * Response: version u8, status u8, generation u64, count u16,
+ *           count × (kind u8, relevance f32, text string, url count u16, url count × url string)
+ *
+ * A client may send several requests on one connection, the responses come in the same order. A response
+ * only has the results that fit into MaxPayloadSize.
+ */
+class IndexProtocol
+{
+public:
+    static constexpr quint8 Version = 2;
+    static constexpr int FrameHeaderSize = 4;
+    // Far above a response with a few dozen results, a larger size means the stream is broken
+    static constexpr quint32 MaxPayloadSize = 1024 * 1024;
+    // Results of a request with limit 0, as many as the runner shows
+    static constexpr int DefaultLimit = 50;
+    // The daemon clamps larger limits, the results of a query are ranked and nobody scrolls further
+    static constexpr int MaxLimit = 1000;
+    // Folders in front of the bookmarks of a response, as many as the runner shows
+    static constexpr int MaxFolderResults = 3;
+
+    enum class RequestType : quint8 {
+        Query = 1,
+    };
+    enum class Status : quint8 {
+        Ok = 0,
+        NotReady = 1, // The daemon did not load the index yet
+        BadRequest = 2,
+    };
+
+    struct Request {
+        RequestType type = RequestType::Query;
+        int limit = 0;
+        QString filter; // Without the trigger word, see BookmarkSearch::parseQuery()
+    };
+
+    enum class ResultKind : quint8 {
+        Bookmark = 0, // Also keywords
+        Folder = 1,
+    };
+
+    struct Result {
+        float relevance = 0;
+        QString text; // As shown in KRunner
+        QString url; // Of a bookmark
+        ResultKind kind = ResultKind::Bookmark;
+        QStringList urls; // Of the bookmarks in a folder
+    };
+
+    struct Response {
+        Status status = Status::Ok;
+        quint64 generation = 0;
+        QVector<Result> results;
+    };
+
+    /**
+     * Complete frames, ready to be written to the socket
+     */
+    static QByteArray encodeRequest(const Request &request);
+    static QByteArray encodeResponse(const Response &response);
+
+    /**
+     * Decode a payload without the frame header, returns false if it is malformed or of another version
+     */
+    static bool decodeRequest(const QByteArray &payload, Request &request);
+    static bool decodeResponse(const QByteArray &payload, Response &response);
+
+    /**
+     * Move the payload of the first complete frame out of the buffer. Returns false if the frame is incomplete,
+     * malformed is set if the size in the header is not plausible.
+     */
+    static bool takeFrame(QByteArray &buffer, QByteArray &payload, bool &malformed);
+
+    /**
+     * Socket in the runtime dir of the user, which is only accessible to them
+     */
+    static QString defaultSocketPath();
+};
@@ -0,0 +1,113 @@
+#include "IndexServer.h"
+
+#include "bookmarks/BookmarkQuery.h"
+#include "bookmarks/BookmarkSearch.h"
+#include "bookmarks/IndexUpdater.h"
+#include "bookmarks/QueryArena.h"
+#include "firefox_debug.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include <algorithm>
+
+IndexServer::IndexServer(IndexUpdater &updater, QObject *parent)
+    : QObject(parent)
+    , m_updater(updater)
+    , m_server(new QLocalServer(this))
+{
+    // The runtime dir is private already, this also covers a socket in the temp dir
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(m_server, &QLocalServer::newConnection, this, &IndexServer::acceptConnections);
+}
+
+IndexServer::~IndexServer() = default;
+
+bool IndexServer::listen(const QString &socketPath)
+{
+    QLocalSocket probe;
+    probe.connectToServer(socketPath);
+    if (probe.waitForConnected(100)) {
+        m_errorString = QStringLiteral("Another daemon is listening on ") + socketPath;
+        return false;
+    }
+    QLocalServer::removeServer(socketPath);
+    if (!m_server->listen(socketPath)) {
+        m_errorString = m_server->errorString();
+        return false;
+    }
+    return true;
+}
+
+IndexProtocol::Response IndexServer::answer(const IndexProtocol::Request &request)
+{
+    ++m_queries;
+    IndexProtocol::Response response;
+    m_updater.scheduleRefresh();
+    const auto snapshot = m_updater.acquire();
+    if (!snapshot) {
+        response.status = IndexProtocol::Status::NotReady;
+        return response;
+    }
+    response.generation = snapshot->generation;
+
+    // Same order as in the runner: a keyword shortcut is what the user asked for
+    QString keywordUrl;
+    if (const BookmarkKeyword *keyword = BookmarkSearch::resolveKeyword(*snapshot, request.filter, keywordUrl)) {
+        const QString title = keyword->title.isEmpty() ? keyword->keyword : keyword->title;
+        response.results.append(IndexProtocol::Result{1.0f, title + " - " + keywordUrl, keywordUrl});
+        return response;
+    }
+
+    const BookmarkQuery query = BookmarkQuery::parse(request.filter);
+    for (const FolderResult &folder : BookmarkSearch::folderSearch(*snapshot, query, IndexProtocol::MaxFolderResults)) {
+        response.results.append(IndexProtocol::Result{folder.relevance, folder.text(), QString(), IndexProtocol::ResultKind::Folder, folder.urls()});
+    }
+
+    // 0 would mean all matches for BookmarkSearch, more than fit into a response for a short filter
+    const int limit = request.limit == 0 ? IndexProtocol::DefaultLimit : std::min(request.limit, IndexProtocol::MaxLimit);
+    QueryArena::Scope arenaScope;
+    BookmarkSearch::Results results(QueryArena::resource());
+    BookmarkSearch::search(*snapshot, query, results, limit);
+    response.results.reserve(response.results.size() + results.size());
+    for (const SearchResult &result : results) {
+        response.results.append(IndexProtocol::Result{result.relevance, result.bookmark->displayText, result.bookmark->url});
+    }
+    return response;
+}
+
+void IndexServer::acceptConnections()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        m_buffers.insert(socket, QByteArray());
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            readRequests(socket);
+        });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            m_buffers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void IndexServer::readRequests(QLocalSocket *socket)
+{
+    QByteArray &buffer = m_buffers[socket];
+    buffer.append(socket->readAll());
+    QByteArray payload;
+    bool malformed = false;
+    while (IndexProtocol::takeFrame(buffer, payload, malformed)) {
+        IndexProtocol::Request request;
+        IndexProtocol::Response response;
+        if (IndexProtocol::decodeRequest(payload, request)) {
+            response = answer(request);
+        } else {
+            response.status = IndexProtocol::Status::BadRequest;
+        }
+        socket->write(IndexProtocol::encodeResponse(response));
+    }
+    if (malformed) {
+        qCDebug(FIREFOX) << "Closing connection with a malformed frame";
+        socket->disconnectFromServer();
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "IndexProtocol.h"
+
+#include <QHash>
+#include <QObject>
+
+class IndexUpdater;
+class QLocalServer;
+class QLocalSocket;
+
+/**
+ * Answers the queries of IndexClient on a Unix socket from the index of an IndexUpdater, used by
+ * zen-bookmark-daemon. Queries run on the thread of the server, a ranked top 20 takes well below a millisecond.
+ */
+class IndexServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit IndexServer(IndexUpdater &updater, QObject *parent = nullptr);
+    ~IndexServer() override;
+
+    /**
+     * Listen on the socket. A stale socket of a crashed daemon is replaced, fails if another daemon answers on it.
+     */
+    bool listen(const QString &socketPath);
+    QString errorString() const
+    {
+        return m_errorString;
+    }
+
+    /**
+     * Search the current generation, also used by the tests without a socket
+     */
+    IndexProtocol::Response answer(const IndexProtocol::Request &request);
+
+    quint64 queries() const
+    {
+        return m_queries;
+    }
+
+private:
+    void acceptConnections();
+    void readRequests(QLocalSocket *socket);
+
+    IndexUpdater &m_updater;
+    QLocalServer *m_server = nullptr;
+    QHash<QLocalSocket *, QByteArray> m_buffers;
+    QString m_errorString;
+    quint64 m_queries = 0;
+};
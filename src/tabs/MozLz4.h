@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Decoder for the mozLz4 files Zen and Firefox use for the session store: the magic "mozLz40\0", the size of the
+ * decompressed data as 32 bit little endian and a single LZ4 block. This has no Qt dependency, so that it can be
+ * fuzzed on its own.
+ */
+class MozLz4
+{
+public:
+    static constexpr std::size_t HeaderSize = 12;
+    // A corrupt header should not make us allocate gigabytes
+    static constexpr std::uint32_t MaxDecompressedSize = 256 * 1024 * 1024;
+
+    /**
+     * Size of the decompressed data, 0 if the header is not valid
+     */
+    static std::uint32_t decompressedSize(const char *data, std::size_t size)
+    {
+        if (size < HeaderSize || std::memcmp(data, "mozLz40\0", 8) != 0) {
+            return 0;
+        }
+        const auto *bytes = reinterpret_cast<const unsigned char *>(data) + 8;
+        const std::uint32_t decompressed = bytes[0] | bytes[1] << 8 | bytes[2] << 16 | std::uint32_t(bytes[3]) << 24;
+        return decompressed <= MaxDecompressedSize ? decompressed : 0;
+    }
+
+    /**
+     * Decode an LZ4 block into dst, returns the number of bytes written or -1 if the block is malformed
+     * or does not fit into dst. Every read and write is bounds checked, the input is untrusted.
+     */
+    static long long decompressBlock(const char *src, std::size_t srcSize, char *dst, std::size_t dstCapacity)
+    {
+        const auto *ip = reinterpret_cast<const unsigned char *>(src);
+        const auto *const iend = ip + srcSize;
+        char *op = dst;
+        char *const oend = dst + dstCapacity;
+
+        while (ip < iend) {
+            const unsigned token = *ip++;
+
+            std::size_t literalLength = token >> 4;
+            if (literalLength == 15 && !readLength(ip, iend, literalLength)) {
+                return -1;
+            }
+            if (std::size_t(iend - ip) < literalLength || std::size_t(oend - op) < literalLength) {
+                return -1;
+            }
+            std::memcpy(op, ip, literalLength);
+            op += literalLength;
+            ip += literalLength;
+            // The last sequence consists of literals only
+            if (ip == iend) {
+                break;
+            }
+
+            if (iend - ip < 2) {
+                return -1;
+            }
+            const std::size_t offset = ip[0] | ip[1] << 8;
+            ip += 2;
+            if (offset == 0 || offset > std::size_t(op - dst)) {
+                return -1;
+            }
+            std::size_t matchLength = token & 15;
+            if (matchLength == 15 && !readLength(ip, iend, matchLength)) {
+                return -1;
+            }
+            matchLength += 4;
+            if (std::size_t(oend - op) < matchLength) {
+                return -1;
+            }
+            const char *match = op - offset;
+            if (offset >= matchLength) {
+                std::memcpy(op, match, matchLength);
+                op += matchLength;
+            } else {
+                // Overlapping match, repeats the last offset bytes
+                for (std::size_t i = 0; i < matchLength; ++i) {
+                    *op++ = *match++;
+                }
+            }
+        }
+        return op - dst;
+    }
+
+private:
+    static bool readLength(const unsigned char *&ip, const unsigned char *iend, std::size_t &length)
+    {
+        unsigned byte = 255;
+        while (byte == 255) {
+            if (ip == iend || length > MaxDecompressedSize) {
+                return false;
+            }
+            byte = *ip++;
+            length += byte;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,140 @@
+#include "OpenTabs.h"
+
+#include "MozLz4.h"
+#include "SessionScanner.h"
+#include "firefox_debug.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+
+#include <algorithm>
+
+std::shared_ptr<const OpenTabs::TabList> OpenTabs::tabs(const QString &sessionPath)
+{
+    const QFileInfo info(sessionPath);
+    QMutexLocker locker(&m_mutex);
+    if (m_tabs && m_path == sessionPath && m_modified == info.lastModified() && m_size == info.size()) {
+        ++m_hits;
+        return m_tabs;
+    }
+    ++m_reads;
+
+    QElapsedTimer timer;
+    timer.start();
+    auto tabs = std::make_shared<TabList>();
+    QFile file(sessionPath);
+    if (file.open(QIODevice::ReadOnly)) {
+        const QByteArray json = decompress(file.readAll());
+        if (json.isNull()) {
+            qCDebug(FIREFOX) << "Invalid mozLz4 data in" << sessionPath;
+        } else {
+            *tabs = parseSession(json);
+        }
+    }
+    qCDebug(FIREFOX) << "Read" << tabs->size() << "open tabs in" << timer.elapsed() << "ms";
+
+    // A file that is replaced while it is read gets a new modification time, so it is read again next time
+    m_path = sessionPath;
+    m_modified = info.lastModified();
+    m_size = info.size();
+    m_tabs = tabs;
+    return m_tabs;
+}
+
+void OpenTabs::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_tabs.reset();
+    m_path.clear();
+}
+
+quint64 OpenTabs::hits() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_hits;
+}
+
+quint64 OpenTabs::reads() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_reads;
+}
+
+bool OpenTabs::parseQuery(const QString &term, QString &filter)
+{
+    static const QRegularExpression filterRegex(R"(^(?:t|tabs?)(?: (.*))?$)", QRegularExpression::CaseInsensitiveOption);
+    const QRegularExpressionMatch match = filterRegex.match(term);
+    if (!match.hasMatch()) {
+        return false;
+    }
+    filter = match.captured(1).trimmed();
+    return true;
+}
+
+QVector<TabResult> OpenTabs::search(const TabList &tabs, const QString &filter)
+{
+    QVector<TabResult> results;
+    for (const OpenTab &tab : tabs) {
+        float relevance = 0.8;
+        if (!filter.isEmpty()) {
+            if (tab.title.startsWith(filter, Qt::CaseInsensitive)) {
+                relevance = 1.0;
+            } else if (tab.title.contains(filter, Qt::CaseInsensitive)) {
+                relevance = 0.9;
+            } else if (!tab.url.contains(filter, Qt::CaseInsensitive) && !tab.workspace.contains(filter, Qt::CaseInsensitive)) {
+                continue;
+            }
+        }
+        results.append(TabResult{&tab, relevance});
+    }
+    std::stable_sort(results.begin(), results.end(), [](const TabResult &a, const TabResult &b) {
+        return a.relevance > b.relevance;
+    });
+    return results;
+}
+
+QByteArray OpenTabs::decompress(const QByteArray &file)
+{
+    const std::uint32_t size = MozLz4::decompressedSize(file.constData(), file.size());
+    if (size == 0) {
+        return QByteArray();
+    }
+    // Written directly by the block decoder, the size from the header bounds the output
+    QByteArray json(size, Qt::Uninitialized);
+    const long long written = MozLz4::decompressBlock(file.constData() + MozLz4::HeaderSize,
+                                                      file.size() - MozLz4::HeaderSize,
+                                                      json.data(),
+                                                      json.size());
+    if (written < 0) {
+        return QByteArray();
+    }
+    json.truncate(written);
+    return json;
+}
+
+OpenTabs::TabList OpenTabs::parseSession(const QByteArray &json)
+{
+    SessionScanner scanner(json.constData(), json.size());
+    if (!scanner.scan()) {
+        qCDebug(FIREFOX) << "Session store is malformed, using the" << scanner.tabs.size() << "tabs read until the error";
+    }
+    QHash<QString, QString> workspaceNames;
+    for (const SessionScanner::Workspace &workspace : scanner.workspaceNames) {
+        workspaceNames.insert(QString::fromStdString(workspace.uuid), QString::fromStdString(workspace.name));
+    }
+
+    TabList tabs;
+    tabs.reserve(scanner.tabs.size());
+    for (const SessionScanner::Tab &scanned : scanner.tabs) {
+        OpenTab tab;
+        tab.url = QString::fromStdString(scanned.url);
+        tab.title = scanned.title.empty() ? tab.url : QString::fromStdString(scanned.title);
+        tab.workspace = QString::fromStdString(scanned.workspace);
+        tab.workspace = workspaceNames.value(tab.workspace, tab.workspace);
+        tab.displayText = tab.title + QLatin1String(" - ") + tab.url;
+        tabs.append(tab);
+    }
+    return tabs;
+}
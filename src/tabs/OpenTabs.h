@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QDateTime>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+
+struct OpenTab {
+    QString title;
+    QString url;
+    QString workspace; // Name of the Zen workspace, or its uuid if the session has no name for it
+    QString displayText; // "title - url", built once when the session is read
+};
+
+struct TabResult {
+    const OpenTab *tab = nullptr;
+    float relevance = 0;
+};
+
+/**
+ * Tabs that are open in Zen, read from sessionstore-backups/recovery.jsonlz4. Zen rewrites the file every few
+ * seconds while it runs, it is only decompressed and scanned again when its modification time or size changed.
+ */
+class OpenTabs
+{
+public:
+    using TabList = QVector<OpenTab>;
+
+    /**
+     * Tabs of the session file, an empty list if it does not exist or can not be read.
+     * The list stays valid while the pointer is held, even if the file is read again.
+     */
+    std::shared_ptr<const TabList> tabs(const QString &sessionPath);
+    void clear();
+    // Calls of tabs() that used the cached list and calls that read the file
+    quint64 hits() const;
+    quint64 reads() const;
+
+    /**
+     * Extract the filter from a KRunner query like "t github", returns false if the query is not for tabs
+     */
+    static bool parseQuery(const QString &term, QString &filter);
+    static QVector<TabResult> search(const TabList &tabs, const QString &filter);
+
+    /**
+     * Decompress a mozLz4 file, returns a null array if the data is not valid
+     */
+    static QByteArray decompress(const QByteArray &file);
+    static TabList parseSession(const QByteArray &json);
+
+private:
+    mutable QMutex m_mutex;
+    quint64 m_hits = 0;
+    quint64 m_reads = 0;
+    QString m_path;
+    QDateTime m_modified;
+    qint64 m_size = -1;
+    std::shared_ptr<const TabList> m_tabs;
+};
@@ -0,0 +1,386 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Single pass scan over the session store JSON that only extracts what the tab search needs. The session
+ * contains form data, scroll positions, closed windows and history entries of every tab, all of that is skipped
+ * without being decoded. Only windows[].tabs[] are read, closed tabs and windows are ignored.
+ * This has no Qt dependency, so that it can be fuzzed on its own.
+ */
+class SessionScanner
+{
+public:
+    struct Tab {
+        std::string url;
+        std::string title;
+        std::string workspace; // Zen workspace uuid, empty if the tab is not assigned to one
+    };
+    struct Workspace {
+        std::string uuid;
+        std::string name;
+    };
+
+    SessionScanner(const char *data, std::size_t size)
+        : m_pos(data)
+        , m_end(data + size)
+    {
+    }
+
+    /**
+     * Returns false if the JSON is malformed, the tabs found until then are kept
+     */
+    bool scan()
+    {
+        return members([this](std::string_view key) {
+            if (key == "windows") {
+                return elements([this]() {
+                    return window();
+                });
+            }
+            if (key == "spaces") {
+                return workspaces();
+            }
+            return skipValue();
+        });
+    }
+
+    std::vector<Tab> tabs;
+    std::vector<Workspace> workspaceNames;
+
+private:
+    bool window()
+    {
+        return members([this](std::string_view key) {
+            if (key == "tabs") {
+                return elements([this]() {
+                    return tab();
+                });
+            }
+            if (key == "spaces") {
+                return workspaces();
+            }
+            return skipValue();
+        });
+    }
+
+    bool tab()
+    {
+        std::vector<Tab> entries;
+        long long index = 0;
+        std::string workspace;
+        const bool ok = members([&](std::string_view key) {
+            if (key == "entries") {
+                return elements([&]() {
+                    Tab entry;
+                    entries.push_back(entry);
+                    return members([&](std::string_view entryKey) {
+                        if (entryKey == "url") {
+                            return stringValue(entries.back().url);
+                        }
+                        if (entryKey == "title") {
+                            return stringValue(entries.back().title);
+                        }
+                        return skipValue();
+                    });
+                });
+            }
+            if (key == "index") {
+                return integerValue(index);
+            }
+            if (key == "zenWorkspace") {
+                return stringValue(workspace);
+            }
+            return skipValue();
+        });
+        if (!ok || entries.empty()) {
+            return ok;
+        }
+        // index is the 1-based position of the current history entry
+        const std::size_t current = index >= 1 && std::size_t(index) <= entries.size() ? std::size_t(index - 1) : entries.size() - 1;
+        Tab &entry = entries[current];
+        if (!entry.url.empty()) {
+            entry.workspace = std::move(workspace);
+            tabs.push_back(std::move(entry));
+        }
+        return true;
+    }
+
+    bool workspaces()
+    {
+        skipWhitespace();
+        if (m_pos == m_end || *m_pos != '[') {
+            return skipValue();
+        }
+        return elements([this]() {
+            Workspace workspace;
+            const bool ok = members([&](std::string_view key) {
+                if (key == "uuid") {
+                    return stringValue(workspace.uuid);
+                }
+                if (key == "name") {
+                    return stringValue(workspace.name);
+                }
+                return skipValue();
+            });
+            if (!workspace.uuid.empty()) {
+                workspaceNames.push_back(std::move(workspace));
+            }
+            return ok;
+        });
+    }
+
+    void skipWhitespace()
+    {
+        while (m_pos != m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t')) {
+            ++m_pos;
+        }
+    }
+
+    bool consume(char c)
+    {
+        skipWhitespace();
+        if (m_pos == m_end || *m_pos != c) {
+            return false;
+        }
+        ++m_pos;
+        return true;
+    }
+
+    /**
+     * Call function(key) for every member of the object, it has to consume the value
+     */
+    template<typename Function>
+    bool members(Function function)
+    {
+        if (!consume('{')) {
+            return false;
+        }
+        if (consume('}')) {
+            return true;
+        }
+        do {
+            std::string_view key;
+            if (!rawString(key) || !consume(':') || !function(key)) {
+                return false;
+            }
+        } while (consume(','));
+        return consume('}');
+    }
+
+    /**
+     * Call function() for every element of the array, it has to consume the element
+     */
+    template<typename Function>
+    bool elements(Function function)
+    {
+        if (!consume('[')) {
+            return false;
+        }
+        if (consume(']')) {
+            return true;
+        }
+        do {
+            if (!function()) {
+                return false;
+            }
+        } while (consume(','));
+        return consume(']');
+    }
+
+    /**
+     * String without decoding the escape sequences, used for the keys
+     */
+    bool rawString(std::string_view &text)
+    {
+        if (!consume('"')) {
+            return false;
+        }
+        const char *begin = m_pos;
+        while (m_pos != m_end && *m_pos != '"') {
+            if (*m_pos == '\\' && ++m_pos == m_end) {
+                return false;
+            }
+            ++m_pos;
+        }
+        if (m_pos == m_end) {
+            return false;
+        }
+        text = std::string_view(begin, m_pos - begin);
+        ++m_pos;
+        return true;
+    }
+
+    /**
+     * Decoded string value, null and other types are skipped and leave the text empty
+     */
+    bool stringValue(std::string &text)
+    {
+        skipWhitespace();
+        if (m_pos == m_end || *m_pos != '"') {
+            return skipValue();
+        }
+        std::string_view raw;
+        if (!rawString(raw)) {
+            return false;
+        }
+        text.clear();
+        text.reserve(raw.size());
+        for (std::size_t i = 0; i < raw.size(); ++i) {
+            if (raw[i] != '\\') {
+                text += raw[i];
+                continue;
+            }
+            const char escaped = raw[++i];
+            switch (escaped) {
+            case 'b':
+                text += '\b';
+                break;
+            case 'f':
+                text += '\f';
+                break;
+            case 'n':
+                text += '\n';
+                break;
+            case 'r':
+                text += '\r';
+                break;
+            case 't':
+                text += '\t';
+                break;
+            case 'u': {
+                unsigned codePoint = 0;
+                if (!hex4(raw, i + 1, codePoint)) {
+                    return false;
+                }
+                i += 4;
+                // Surrogate pair
+                unsigned low = 0;
+                if (codePoint >= 0xD800 && codePoint < 0xDC00 && i + 6 < raw.size() && raw[i + 1] == '\\' && raw[i + 2] == 'u'
+                    && hex4(raw, i + 3, low) && low >= 0xDC00 && low < 0xE000) {
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    i += 6;
+                }
+                appendUtf8(text, codePoint);
+                break;
+            }
+            default:
+                text += escaped;
+            }
+        }
+        return true;
+    }
+
+    bool integerValue(long long &value)
+    {
+        skipWhitespace();
+        const bool negative = m_pos != m_end && *m_pos == '-';
+        const char *digits = negative ? m_pos + 1 : m_pos;
+        if (digits == m_end || *digits < '0' || *digits > '9') {
+            return skipValue();
+        }
+        value = 0;
+        for (m_pos = digits; m_pos != m_end && *m_pos >= '0' && *m_pos <= '9'; ++m_pos) {
+            value = value * 10 + (*m_pos - '0');
+        }
+        if (negative) {
+            value = -value;
+        }
+        // Fractions and exponents are not expected, skip them anyway
+        return skipValue();
+    }
+
+    /**
+     * Skip any value without recursion, nested containers only need a depth counter
+     */
+    bool skipValue()
+    {
+        skipWhitespace();
+        if (m_pos == m_end) {
+            return false;
+        }
+        if (*m_pos == '"') {
+            std::string_view ignored;
+            return rawString(ignored);
+        }
+        if (*m_pos != '{' && *m_pos != '[') {
+            // Number, literal or the remainder of one
+            while (m_pos != m_end && *m_pos != ',' && *m_pos != '}' && *m_pos != ']' && *m_pos != ' ' && *m_pos != '\n'
+                   && *m_pos != '\r' && *m_pos != '\t') {
+                ++m_pos;
+            }
+            return true;
+        }
+        int depth = 0;
+        while (m_pos != m_end) {
+            switch (*m_pos) {
+            case '"': {
+                std::string_view ignored;
+                if (!rawString(ignored)) {
+                    return false;
+                }
+                continue;
+            }
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            case '}':
+            case ']':
+                if (--depth == 0) {
+                    ++m_pos;
+                    return true;
+                }
+                break;
+            }
+            ++m_pos;
+        }
+        return false;
+    }
+
+    static bool hex4(std::string_view raw, std::size_t position, unsigned &value)
+    {
+        if (position + 4 > raw.size()) {
+            return false;
+        }
+        value = 0;
+        for (std::size_t i = position; i < position + 4; ++i) {
+            const char c = raw[i];
+            value <<= 4;
+            if (c >= '0' && c <= '9') {
+                value |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                value |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                value |= c - 'A' + 10;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void appendUtf8(std::string &text, unsigned codePoint)
+    {
+        if (codePoint < 0x80) {
+            text += char(codePoint);
+        } else if (codePoint < 0x800) {
+            text += char(0xC0 | codePoint >> 6);
+            text += char(0x80 | (codePoint & 0x3F));
+        } else if (codePoint < 0x10000) {
+            text += char(0xE0 | codePoint >> 12);
+            text += char(0x80 | (codePoint >> 6 & 0x3F));
+            text += char(0x80 | (codePoint & 0x3F));
+        } else {
+            text += char(0xF0 | codePoint >> 18);
+            text += char(0x80 | (codePoint >> 12 & 0x3F));
+            text += char(0x80 | (codePoint >> 6 & 0x3F));
+            text += char(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    const char *m_pos;
+    const char *const m_end;
+};
@@ -0,0 +1,401 @@
+#include "TestIndex.h"
+#include "bookmarks/BookmarkSearch.h"
+#include "bookmarks/EditDistance.h"
+#include "bookmarks/QueryArena.h"
+#include <QRandomGenerator>
+#include <QTest>
+
+#include <algorithm>
+#include <climits>
+
+class BookmarkSearchTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static BookmarkIndex createIndex()
+    {
+        return TestIndex::create({
+            TestIndex::bookmark("GitHub", "https://github.com/"),
+            TestIndex::bookmark("Grafana Production", "https://grafana.example.com/d/prod"),
+            TestIndex::bookmark("Rust Documentation", "https://doc.rust-lang.org/"),
+        });
+    }
+
+    /**
+     * Titles of random words, "grafana" appears in every 1000th
+     */
+    static BookmarkIndex createLargeIndex(int count)
+    {
+        static const QStringList words{"github", "rust", "plasma", "docs", "wiki", "release", "notes", "issue", "pull", "request", "kde", "blog"};
+        QRandomGenerator random(42);
+        BookmarkIndex index;
+        for (int i = 1; i <= count; ++i) {
+            QStringList titleWords;
+            for (int word = 2 + random.bounded(4); word > 0; --word) {
+                titleWords.append(words.at(random.bounded(words.size())));
+            }
+            if (i % 1000 == 0) {
+                titleWords.insert(random.bounded(titleWords.size()), QStringLiteral("grafana"));
+            }
+            Bookmark bookmark;
+            bookmark.id = i;
+            bookmark.title = titleWords.join(QLatin1Char(' '));
+            bookmark.url = QStringLiteral("https://example.com/%1/%2").arg(titleWords.first()).arg(i);
+            index.upsert(bookmark);
+        }
+        return index;
+    }
+
+    static QVector<SearchResult> search(const BookmarkIndex &index, const QString &filter, int parallelThreshold, int limit)
+    {
+        const int previous = BookmarkSearch::parallelThreshold();
+        BookmarkSearch::setParallelThreshold(parallelThreshold);
+        QueryArena::Scope arenaScope;
+        BookmarkSearch::Results results(QueryArena::resource());
+        BookmarkSearch::search(index, BookmarkQuery::parse(filter), results, limit);
+        BookmarkSearch::setParallelThreshold(previous);
+        return QVector<SearchResult>(results.cbegin(), results.cend());
+    }
+
+    static bool sameResults(const QVector<SearchResult> &a, const QVector<SearchResult> &b)
+    {
+        return std::equal(a.cbegin(), a.cend(), b.cbegin(), b.cend(), [](const SearchResult &x, const SearchResult &y) {
+            return x.bookmark == y.bookmark && x.relevance == y.relevance;
+        });
+    }
+
+    static int distance(const QString &pattern, const QString &text, int maxDistance)
+    {
+        const EditDistance editDistance(reinterpret_cast<const char16_t *>(pattern.utf16()), pattern.size());
+        return editDistance.distance(reinterpret_cast<const char16_t *>(text.utf16()), text.size(), maxDistance);
+    }
+
+    static int prefixDistance(const QString &pattern, const QString &text, int maxDistance)
+    {
+        const EditDistance editDistance(reinterpret_cast<const char16_t *>(pattern.utf16()), pattern.size());
+        return editDistance.prefixDistance(reinterpret_cast<const char16_t *>(text.utf16()), text.size(), maxDistance);
+    }
+
+private Q_SLOTS:
+    /**
+     * Substitutions, insertions, deletions and transpositions count as one edit each
+     */
+    static void testEditDistance()
+    {
+        QCOMPARE(distance("github", "github", 2), 0);
+        QCOMPARE(distance("githbu", "github", 2), 1);
+        QCOMPARE(distance("gthub", "github", 2), 1);
+        QCOMPARE(distance("grafnaa", "grafana", 2), 1);
+        QCOMPARE(distance("grafanna", "grafana", 2), 1);
+        QCOMPARE(distance("kitten", "sitting", 2), 3);
+        QCOMPARE(distance("abc", "abcdef", 2), 3);
+    }
+
+    /**
+     * Partially typed words are compared against the closest prefix
+     */
+    static void testPrefixDistance()
+    {
+        QCOMPARE(prefixDistance("prod", "production", 1), 0);
+        QCOMPARE(prefixDistance("porduc", "production", 2), 1);
+        QCOMPARE(prefixDistance("xyz", "production", 1), 2);
+    }
+
+    /**
+     * Queries with typos find the bookmark if the substring search finds nothing
+     */
+    static void testTypoSearch()
+    {
+        const BookmarkIndex index = createIndex();
+        QVector<SearchResult> results = BookmarkSearch::search(index, "githbu");
+        QCOMPARE(results.size(), 1);
+        QCOMPARE(results.first().bookmark->title, "GitHub");
+
+        results = BookmarkSearch::search(index, "grafnaa prod");
+        QCOMPARE(results.size(), 1);
+        QCOMPARE(results.first().bookmark->title, "Grafana Production");
+
+        QVERIFY(BookmarkSearch::search(index, "bitbucket").isEmpty());
+    }
+
+    /**
+     * Exact substring matches are ranked above typo tolerant matches
+     */
+    static void testExactMatchesFirst()
+    {
+        const BookmarkIndex index = createIndex();
+        const QVector<SearchResult> results = BookmarkSearch::search(index, "rust");
+        QCOMPARE(results.size(), 1);
+        QVERIFY(results.first().relevance >= 0.9f);
+    }
+
+    /**
+     * URL matches rank the host above the path, query values and tracking parameters are not searchable
+     */
+    static void testUrlFields()
+    {
+        const BookmarkIndex index = TestIndex::create({
+            TestIndex::bookmark("Docs", "https://kde.org/docs?utm_source=news&page=2"),
+            TestIndex::bookmark("Wiki", "https://example.com/kde/wiki"),
+        });
+
+        const QVector<SearchResult> results = BookmarkSearch::search(index, "kde");
+        QCOMPARE(results.size(), 2);
+        QCOMPARE(results.first().bookmark->title, "Docs");
+        QVERIFY(results.first().relevance > results.last().relevance);
+
+        QCOMPARE(BookmarkSearch::urlSearch(index, "example wiki").size(), 1);
+        QCOMPARE(BookmarkSearch::urlSearch(index, "page").size(), 1);
+        QVERIFY(BookmarkSearch::urlSearch(index, "news").isEmpty());
+        QVERIFY(BookmarkSearch::urlSearch(index, "utm").isEmpty());
+    }
+
+    /**
+     * Terms are AND-ed and each can be anywhere in the title, operators restrict the candidates
+     */
+    static void testQueryOperators()
+    {
+        const BookmarkIndex index = TestIndex::create({
+            TestIndex::bookmark("Grafana Production", "https://grafana.example.com/d/prod", "Work", {"runbook"}),
+            TestIndex::bookmark("Grafana Staging", "https://grafana.example.com/d/staging", "Work"),
+            TestIndex::bookmark("Production checklist", "https://github.com/example/docs", "Work", {"runbook"}),
+            TestIndex::bookmark("Rust repository", "https://github.com/rust-lang/rust", "Reading"),
+        });
+        const auto titles = [&index](const QString &filter) {
+            QStringList titles;
+            for (const SearchResult &result : BookmarkSearch::search(index, filter)) {
+                titles.append(result.bookmark->title);
+            }
+            return titles;
+        };
+
+        QCOMPARE(titles("prod grafana"), QStringList{"Grafana Production"});
+        QCOMPARE(titles("\"grafana prod\""), QStringList{"Grafana Production"});
+        QCOMPARE(titles("grafana -staging"), QStringList{"Grafana Production"});
+        QCOMPARE(titles("site:github.com"), (QStringList{"Production checklist", "Rust repository"}));
+        QCOMPARE(titles("site:https://www.github.com/ rust"), QStringList{"Rust repository"});
+        QCOMPARE(titles("site:example.com"), (QStringList{"Grafana Production", "Grafana Staging"}));
+        QCOMPARE(titles("tag:runbook folder:work"), (QStringList{"Grafana Production", "Production checklist"}));
+        QCOMPARE(titles("tag:runbook github"), QStringList{"Production checklist"});
+        QCOMPARE(titles("folder:\"reading\""), QStringList{"Rust repository"});
+        QVERIFY(titles("tag:missing").isEmpty());
+        QVERIFY(titles("site:hub.com").isEmpty());
+    }
+
+    /**
+     * Folders are matched by folder: alone or by their title, their URLs come in the order of the folder
+     */
+    static void testFolderSearch()
+    {
+        const auto entry = [](const QString &title, const QString &folder, qint64 folderId, int position) {
+            Bookmark bookmark = TestIndex::bookmark(title, QStringLiteral("https://example.com/") + title.toLower(), folder);
+            bookmark.folderId = folderId;
+            bookmark.position = position;
+            return bookmark;
+        };
+        const BookmarkIndex index = TestIndex::create({
+            entry("Alerts", "Oncall", 10, 2),
+            entry("Runbooks", "Oncall", 10, 0),
+            entry("Dashboards", "Oncall", 10, 1),
+            entry("Pager", "Oncall archive", 11, 0),
+            entry("Old pager", "Oncall archive", 11, 1),
+            entry("Rust", "Reading", 12, 0),
+        });
+        const auto folders = [&index](const QString &filter) {
+            QStringList folders;
+            for (const FolderResult &result : BookmarkSearch::folderSearch(index, BookmarkQuery::parse(filter), 3)) {
+                QStringList titles;
+                for (const Bookmark *bookmark : result.bookmarks) {
+                    titles.append(bookmark->title);
+                }
+                folders.append(result.title + QLatin1Char(':') + titles.join(QLatin1Char(',')));
+            }
+            return folders;
+        };
+
+        QCOMPARE(folders("folder:oncall"), QStringList{"Oncall:Runbooks,Dashboards,Alerts"});
+        QCOMPARE(folders("oncall"), (QStringList{"Oncall:Runbooks,Dashboards,Alerts", "Oncall archive:Pager,Old pager"}));
+        QCOMPARE(folders("archive"), QStringList{"Oncall archive:Pager,Old pager"});
+        // Too small to be worth it, and operators that select single bookmarks
+        QVERIFY(folders("reading").isEmpty());
+        QVERIFY(folders("folder:oncall alerts").isEmpty());
+        QVERIFY(folders("oncall -pager").isEmpty());
+    }
+
+    static void testParseQuery()
+    {
+        const BookmarkQuery query = BookmarkQuery::parse(R"(grafana site:GitHub.com -"old notes" folder:"Side projects" http://x "a  b)");
+        QCOMPARE(query.terms, (QStringList{"grafana", "http://x", "a b"}));
+        QCOMPARE(query.sites, QStringList{"github.com"});
+        QCOMPARE(query.excluded, QStringList{"old notes"});
+        QCOMPARE(query.folders, QStringList{"Side projects"});
+        QVERIFY(query.tags.isEmpty());
+    }
+
+    /**
+     * The first word is looked up as keyword and %s is replaced with the rest of the query
+     */
+    static void testKeywords()
+    {
+        BookmarkIndex index = createIndex();
+        index.setKeywords({
+            {"gh", BookmarkKeyword{"gh", "GitHub", "https://github.com/%s"}},
+            {"ddg", BookmarkKeyword{"ddg", "DuckDuckGo", "https://duckduckgo.com/?q=%s"}},
+        });
+
+        QString url;
+        const BookmarkKeyword *keyword = BookmarkSearch::resolveKeyword(index, "gh rust-lang/rust", url);
+        QVERIFY(keyword);
+        QCOMPARE(keyword->title, "GitHub");
+        QCOMPARE(url, "https://github.com/rust-lang/rust");
+
+        QVERIFY(BookmarkSearch::resolveKeyword(index, "DDG qt widgets", url));
+        QCOMPARE(url, "https://duckduckgo.com/?q=qt%20widgets");
+
+        QVERIFY(!BookmarkSearch::resolveKeyword(index, "github", url));
+        QVERIFY(!BookmarkSearch::resolveKeyword(index, "rust gh", url));
+    }
+
+    /**
+     * Chunked scoring on the thread pool finds and orders the same results as scoring inline, and the
+     * per-chunk top K of a limited search are the head of the full ranking
+     */
+    static void testParallelScoring()
+    {
+        const BookmarkIndex index = createLargeIndex(20000);
+        // Many matches, few matches, URL tokens and the typo tolerant fallback
+        for (const QString &filter : {QStringLiteral("release"), QStringLiteral("grafana"), QStringLiteral("example notes"), QStringLiteral("grafnaa")}) {
+            const QVector<SearchResult> inlineResults = search(index, filter, INT_MAX, 0);
+            QVERIFY2(!inlineResults.isEmpty(), qPrintable(filter));
+            QVERIFY2(sameResults(search(index, filter, 1, 0), inlineResults), qPrintable(filter));
+
+            const QVector<SearchResult> top = search(index, filter, 1, 10);
+            QCOMPARE(top.size(), std::min<int>(10, inlineResults.size()));
+            QVERIFY2(sameResults(top, inlineResults.mid(0, top.size())), qPrintable(filter));
+            QVERIFY2(sameResults(search(index, filter, INT_MAX, 10), top), qPrintable(filter));
+        }
+    }
+
+    /**
+     * One and two character queries are answered from the word start lists, acronyms are found for longer ones too
+     */
+    static void testShortQueries()
+    {
+        QList<Bookmark> bookmarks{
+            TestIndex::bookmark("GitHub", "https://github.com/"),
+            TestIndex::bookmark("Google Cloud Platform", "https://console.cloud.google.com/"),
+            TestIndex::bookmark("Highlights", "https://example.com/highlights"),
+        };
+        for (int i = 0; i < 100; ++i) {
+            Bookmark gizmo = TestIndex::bookmark(QStringLiteral("Gizmo %1").arg(i), QStringLiteral("https://example.org/%1").arg(i));
+            gizmo.frecency = i;
+            bookmarks.append(gizmo);
+        }
+        BookmarkIndex index = TestIndex::create(bookmarks);
+        QVERIFY(index.wordStarts().isEmpty());
+        index.buildWordStarts();
+
+        // The most frecent of the titles starting with the query, ranked like any other results
+        const QVector<SearchResult> top = search(index, "gi", INT_MAX, 5);
+        QCOMPARE(top.size(), 5);
+        for (const SearchResult &result : top) {
+            QCOMPARE(result.relevance, 1.0f);
+            QVERIFY(result.bookmark->frecency >= 95);
+        }
+        QVERIFY(std::is_sorted(top.cbegin(), top.cend(), BookmarkSearch::ranksBefore));
+
+        // Hosts fill the list, but a title that contains the query ranks above them and only the scan finds it
+        QList<Bookmark> hosts{TestIndex::bookmark("Logistics", "https://example.net/shipping")};
+        for (int i = 0; i < 100; ++i) {
+            Bookmark host = TestIndex::bookmark(QStringLiteral("Page %1").arg(i), QStringLiteral("https://gizmo%1.example.com/").arg(i));
+            host.frecency = 1000 + i;
+            hosts.append(host);
+        }
+        BookmarkIndex hostIndex = TestIndex::create(hosts);
+        hostIndex.buildWordStarts();
+        QCOMPARE(hostIndex.wordStarts().entries(u"gi")->size(), WordStartIndex::ListSize);
+        QVERIFY(hostIndex.wordStarts().entries(u"gi")->first().relevance < WordStartIndex::TitleStartRelevance);
+        const QVector<SearchResult> logistics = search(hostIndex, "gi", INT_MAX, 5);
+        QCOMPARE(logistics.size(), 5);
+        QCOMPARE(logistics.first().bookmark->title, "Logistics");
+        QCOMPARE(logistics.first().relevance, WordStartIndex::TitleWordRelevance);
+        QVERIFY(std::is_sorted(logistics.cbegin(), logistics.cend(), BookmarkSearch::ranksBefore));
+
+        // Too few word starts, the scan finds the substring and the acronym is added
+        const QVector<SearchResult> gh = search(index, "gh", INT_MAX, 5);
+        QCOMPARE(gh.size(), 2);
+        QCOMPARE(gh.at(0).bookmark->title, "Highlights");
+        QCOMPARE(gh.at(1).bookmark->title, "GitHub");
+        QCOMPARE(gh.at(1).relevance, WordStartIndex::AcronymRelevance);
+
+        const QVector<SearchResult> gcp = BookmarkSearch::search(index, "GCP");
+        QVERIFY(!gcp.isEmpty());
+        QCOMPARE(gcp.first().bookmark->title, "Google Cloud Platform");
+        // Words of the title and labels of the host, but not the public suffix
+        QVERIFY(index.wordStarts().entries(u"cl"));
+        QCOMPARE(index.wordStarts().entries(u"cl")->first().id, qint64(2));
+        QVERIFY(index.wordStarts().entries(u"co"));
+        QCOMPARE(index.wordStarts().entries(u"co")->size(), 1);
+
+        // Changing the bookmarks drops the lists, the scan ranks all title prefixes by title again
+        Bookmark changed = *index.find(3);
+        changed.title = QStringLiteral("Highlights of the week");
+        index.upsert(changed);
+        QVERIFY(index.wordStarts().isEmpty());
+        QCOMPARE(search(index, "gi", INT_MAX, 5).first().bookmark->title, "GitHub");
+    }
+
+    static void benchmarkScoring_data()
+    {
+        QTest::addColumn<bool>("parallel");
+        QTest::addColumn<int>("entries");
+        for (const int entries : {10000, 100000}) {
+            QTest::addRow("inline %d", entries) << false << entries;
+            QTest::addRow("parallel %d", entries) << true << entries;
+        }
+    }
+
+    /**
+     * Search of all bookmarks for a word in about a sixth of the titles, to find the parallel threshold
+     */
+    static void benchmarkScoring()
+    {
+        QFETCH(bool, parallel);
+        QFETCH(int, entries);
+        const BookmarkIndex index = createLargeIndex(entries);
+        QVector<SearchResult> results;
+        QBENCHMARK {
+            results = search(index, QStringLiteral("relea"), parallel ? 1 : INT_MAX, 50);
+        }
+        QCOMPARE(results.size(), 50);
+    }
+
+    static void benchmarkShortQuery_data()
+    {
+        QTest::addColumn<bool>("wordStarts");
+        QTest::newRow("scan") << false;
+        QTest::newRow("word starts") << true;
+    }
+
+    /**
+     * Two characters that start a word in most of 100k titles
+     */
+    static void benchmarkShortQuery()
+    {
+        QFETCH(bool, wordStarts);
+        BookmarkIndex index = createLargeIndex(100000);
+        if (wordStarts) {
+            index.buildWordStarts();
+        }
+        QVector<SearchResult> results;
+        QBENCHMARK {
+            results = search(index, QStringLiteral("re"), BookmarkSearch::DefaultParallelThreshold, 50);
+        }
+        QCOMPARE(results.size(), 50);
+    }
+};
+
+QTEST_MAIN(BookmarkSearchTest)
+
+#include "BookmarkSearchTest.moc"
@@ -0,0 +1,31 @@
+#include "CountingAllocator.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<int> s_allocations{0};
+
+void *operator new(std::size_t size)
+{
+    ++s_allocations;
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+int CountingAllocator::allocations()
+{
+    return s_allocations;
+}
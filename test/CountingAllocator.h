@@ -0,0 +1,12 @@
+#pragma once
+
+/**
+ * Replaces the global operator new of the test executable and counts its calls, e.g. to check that the search
+ * or the match payload do not allocate. Portable, unlike CountingHooks, but blind to malloc calls like the ones
+ * of QArrayData.
+ */
+class CountingAllocator
+{
+public:
+    static int allocations();
+};
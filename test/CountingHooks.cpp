@@ -0,0 +1,190 @@
+// The hooks define open() itself, neither the fortified inline wrappers nor the redirect to open64 may apply
+#undef _FORTIFY_SOURCE
+#undef _FILE_OFFSET_BITS
+
+#include "CountingHooks.h"
+
+#include <atomic>
+
+#if defined(__GLIBC__)
+#include <cerrno>
+#include <cstdarg>
+#include <cstddef>
+#include <dlfcn.h>
+#include <fcntl.h>
+
+namespace
+{
+// Plain thread locals of the executable, reading them does not allocate
+thread_local bool t_counting = false;
+thread_local quint64 t_allocations = 0;
+std::atomic<bool> s_countingOpens{false};
+std::atomic<quint64> s_opens{0};
+std::atomic<quint64> s_creates{0};
+
+void countAllocation()
+{
+    if (t_counting) {
+        ++t_allocations;
+    }
+}
+
+void countOpen(int flags)
+{
+    if (s_countingOpens.load(std::memory_order_relaxed)) {
+        ++s_opens;
+        if (flags & (O_CREAT | O_TMPFILE)) {
+            ++s_creates;
+        }
+    }
+}
+
+using OpenFunction = int (*)(const char *, int, ...);
+using OpenAtFunction = int (*)(int, const char *, int, ...);
+
+OpenFunction nextOpen(const char *name)
+{
+    return reinterpret_cast<OpenFunction>(dlsym(RTLD_NEXT, name));
+}
+
+OpenAtFunction nextOpenAt(const char *name)
+{
+    return reinterpret_cast<OpenAtFunction>(dlsym(RTLD_NEXT, name));
+}
+
+// The mode argument is only passed if the file may be created
+mode_t modeArgument(int flags, va_list arguments)
+{
+    return flags & (O_CREAT | O_TMPFILE) ? mode_t(va_arg(arguments, int)) : 0;
+}
+}
+
+// The build hides symbols by default, the hooks have to be visible to the libraries they replace the functions of
+#define HOOK __attribute__((visibility("default")))
+
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *pointer, std::size_t size);
+void *__libc_memalign(std::size_t alignment, std::size_t size);
+
+HOOK void *malloc(std::size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+HOOK void *calloc(std::size_t count, std::size_t size)
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+HOOK void *realloc(void *pointer, std::size_t size)
+{
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+
+HOOK void *memalign(std::size_t alignment, std::size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+HOOK void *aligned_alloc(std::size_t alignment, std::size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+HOOK int posix_memalign(void **result, std::size_t alignment, std::size_t size)
+{
+    countAllocation();
+    *result = __libc_memalign(alignment, size);
+    return *result ? 0 : ENOMEM;
+}
+
+HOOK int open(const char *path, int flags, ...)
+{
+    va_list arguments;
+    va_start(arguments, flags);
+    const mode_t mode = modeArgument(flags, arguments);
+    va_end(arguments);
+    countOpen(flags);
+    static const OpenFunction next = nextOpen("open");
+    return next(path, flags, mode);
+}
+
+HOOK int open64(const char *path, int flags, ...)
+{
+    va_list arguments;
+    va_start(arguments, flags);
+    const mode_t mode = modeArgument(flags, arguments);
+    va_end(arguments);
+    countOpen(flags);
+    static const OpenFunction next = nextOpen("open64");
+    return next(path, flags, mode);
+}
+
+HOOK int openat(int directory, const char *path, int flags, ...)
+{
+    va_list arguments;
+    va_start(arguments, flags);
+    const mode_t mode = modeArgument(flags, arguments);
+    va_end(arguments);
+    countOpen(flags);
+    static const OpenAtFunction next = nextOpenAt("openat");
+    return next(directory, path, flags, mode);
+}
+
+HOOK int openat64(int directory, const char *path, int flags, ...)
+{
+    va_list arguments;
+    va_start(arguments, flags);
+    const mode_t mode = modeArgument(flags, arguments);
+    va_end(arguments);
+    countOpen(flags);
+    static const OpenAtFunction next = nextOpenAt("openat64");
+    return next(directory, path, flags, mode);
+}
+}
+
+bool CountingHooks::isSupported()
+{
+    return true;
+}
+
+void CountingHooks::start()
+{
+    s_opens = 0;
+    s_creates = 0;
+    s_countingOpens = true;
+    t_allocations = 0;
+    t_counting = true;
+}
+
+CountingHooks::Counts CountingHooks::stop()
+{
+    t_counting = false;
+    s_countingOpens = false;
+    return Counts{t_allocations, s_opens.load(), s_creates.load()};
+}
+
+#else
+
+bool CountingHooks::isSupported()
+{
+    return false;
+}
+
+void CountingHooks::start()
+{
+}
+
+CountingHooks::Counts CountingHooks::stop()
+{
+    return Counts{};
+}
+
+#endif
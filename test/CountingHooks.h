@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QtGlobal>
+
+/**
+ * Counts heap allocations and file opens around a piece of code, for the budgets of the query path.
+ * The hooks replace malloc and open of glibc in the test executable, operator new and the allocations of Qt and
+ * SQLite end up there as well. Allocations are counted on the calling thread only, the thread pools of the runner
+ * and of Qt allocate concurrently. Opens are counted on every thread, work a query starts in the background
+ * must not touch files either.
+ */
+class CountingHooks
+{
+public:
+    struct Counts {
+        quint64 allocations = 0;
+        quint64 opens = 0;
+        quint64 creates = 0; // Opens with O_CREAT or O_TMPFILE: copies, temp files and new databases
+    };
+
+    /**
+     * False without glibc, the hooks are not installed then and nothing is counted
+     */
+    static bool isSupported();
+    static void start();
+    static Counts stop();
+};
@@ -0,0 +1,363 @@
+#include "bookmarks/BookmarkSearch.h"
+#include "bookmarks/IndexUpdater.h"
+#include "bookmarks/MatchPayload.h"
+#include "firefoxprofilerunner.h"
+#include "service/IndexClient.h"
+#include "service/IndexProtocol.h"
+#include "service/IndexServer.h"
+#include <KPluginMetaData>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+static constexpr int bookmarkCount = 500;
+
+class IndexServiceTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    /**
+     * The client blocks, it runs on another thread while this one serves the socket
+     */
+    static void runClient(const std::function<void()> &function)
+    {
+        // The loop wakes up as soon as a request arrives, the client has its own timeouts
+        QEventLoop loop;
+        std::thread thread([&]() {
+            function();
+            QMetaObject::invokeMethod(&loop, &QEventLoop::quit, Qt::QueuedConnection);
+        });
+        loop.exec();
+        thread.join();
+    }
+
+    QTemporaryDir m_dir;
+    QString m_socketPath;
+    IndexUpdater m_updater;
+    IndexServer m_server{m_updater};
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+        QVERIFY(m_dir.isValid());
+        // The runner finds the profile below the home directory and the daemon in the runtime directory
+        qputenv("HOME", QFile::encodeName(m_dir.path()));
+        qputenv("XDG_RUNTIME_DIR", QFile::encodeName(m_dir.path()));
+        const QString profile = m_dir.filePath(QStringLiteral(".var/app/app.zen_browser.zen/.zen/cr6uussi.Default (release)"));
+        QVERIFY(QDir().mkpath(profile));
+        const QString placesPath = profile + QStringLiteral("/places.sqlite");
+        QCOMPARE(QProcess::execute(QStringLiteral(PLACES_WRITER_EXECUTABLE), {QStringLiteral("init"), placesPath, QString::number(bookmarkCount)}), 0);
+        QCOMPARE(QProcess::execute(QStringLiteral(PLACES_WRITER_EXECUTABLE), {QStringLiteral("favicons"), profile + QStringLiteral("/favicons.sqlite"), placesPath}),
+                 0);
+        m_updater.setSourcePath(placesPath);
+        m_updater.scheduleRefresh();
+        m_updater.waitForDone();
+        QVERIFY(m_updater.acquire());
+        m_socketPath = IndexProtocol::defaultSocketPath();
+        QCOMPARE(m_socketPath, m_dir.filePath(QStringLiteral("zen-bookmark.sock")));
+        QVERIFY2(m_server.listen(m_socketPath), qPrintable(m_server.errorString()));
+    }
+
+    static void testProtocolRoundTrip()
+    {
+        QByteArray buffer = IndexProtocol::encodeRequest(IndexProtocol::Request{IndexProtocol::RequestType::Query, 20, QStringLiteral("site:kde.org Ünïcødé 🦀")});
+        IndexProtocol::Response response;
+        response.generation = 7;
+        response.results.append(IndexProtocol::Result{0.75f, QStringLiteral("Plasma 🦀 - https://kde.org/"), QStringLiteral("https://kde.org/")});
+        response.results.append(IndexProtocol::Result{0.5f, QString(), QStringLiteral("about:blank")});
+        const QStringList folderUrls{QStringLiteral("https://kde.org/"), QStringLiteral("https://invent.kde.org/")};
+        response.results.append(IndexProtocol::Result{0.9f, QStringLiteral("KDE - open all 2 bookmarks"), QString(), IndexProtocol::ResultKind::Folder, folderUrls});
+        buffer += IndexProtocol::encodeResponse(response);
+
+        // Both frames arrive in one read
+        QByteArray payload;
+        bool malformed = true;
+        QVERIFY(IndexProtocol::takeFrame(buffer, payload, malformed));
+        IndexProtocol::Request request;
+        QVERIFY(IndexProtocol::decodeRequest(payload, request));
+        QCOMPARE(request.limit, 20);
+        QCOMPARE(request.filter, QStringLiteral("site:kde.org Ünïcødé 🦀"));
+
+        QVERIFY(IndexProtocol::takeFrame(buffer, payload, malformed));
+        QVERIFY(buffer.isEmpty());
+        IndexProtocol::Response decoded;
+        QVERIFY(IndexProtocol::decodeResponse(payload, decoded));
+        QCOMPARE(decoded.generation, quint64(7));
+        QCOMPARE(decoded.results.size(), 3);
+        QCOMPARE(decoded.results.at(0).relevance, 0.75f);
+        QCOMPARE(decoded.results.at(0).text, response.results.at(0).text);
+        QCOMPARE(decoded.results.at(0).kind, IndexProtocol::ResultKind::Bookmark);
+        QCOMPARE(decoded.results.at(1).url, QStringLiteral("about:blank"));
+        QCOMPARE(decoded.results.at(2).kind, IndexProtocol::ResultKind::Folder);
+        QCOMPARE(decoded.results.at(2).urls, folderUrls);
+        QVERIFY(decoded.results.at(2).url.isEmpty());
+    }
+
+    static void testMalformedFrames()
+    {
+        IndexProtocol::Response response;
+        response.results.append(IndexProtocol::Result{1.0f, QStringLiteral("GitHub"), QStringLiteral("https://github.com/")});
+        const QByteArray frame = IndexProtocol::encodeResponse(response);
+        const QByteArray payload = frame.mid(IndexProtocol::FrameHeaderSize);
+
+        // Every truncation is incomplete as a frame and malformed as a payload
+        for (int size = 0; size < frame.size(); ++size) {
+            QByteArray buffer = frame.left(size);
+            QByteArray taken;
+            bool malformed = true;
+            QVERIFY(!IndexProtocol::takeFrame(buffer, taken, malformed));
+            QVERIFY(!malformed);
+        }
+        IndexProtocol::Response decoded;
+        for (int size = 0; size < payload.size(); ++size) {
+            QVERIFY(!IndexProtocol::decodeResponse(payload.left(size), decoded));
+        }
+        QVERIFY(!IndexProtocol::decodeResponse(payload + QByteArray(1, '\0'), decoded));
+
+        QByteArray otherVersion = payload;
+        otherVersion[0] = char(IndexProtocol::Version + 1);
+        QVERIFY(!IndexProtocol::decodeResponse(otherVersion, decoded));
+
+        QByteArray huge(IndexProtocol::FrameHeaderSize, '\xff');
+        QByteArray taken;
+        bool malformed = false;
+        QVERIFY(!IndexProtocol::takeFrame(huge, taken, malformed));
+        QVERIFY(malformed);
+    }
+
+    /**
+     * A response with more results than fit into a frame is cut, the client must not drop it as malformed
+     */
+    static void testResponseSizeLimit()
+    {
+        IndexProtocol::Response response;
+        for (int i = 0; i < 40; ++i) {
+            response.results.append(IndexProtocol::Result{1.0f, QString(60000, QLatin1Char('a' + i % 26)), QStringLiteral("https://example.com/%1").arg(i)});
+        }
+        QByteArray buffer = IndexProtocol::encodeResponse(response);
+        QVERIFY(buffer.size() <= IndexProtocol::FrameHeaderSize + qsizetype(IndexProtocol::MaxPayloadSize));
+
+        QByteArray payload;
+        bool malformed = true;
+        QVERIFY(IndexProtocol::takeFrame(buffer, payload, malformed));
+        IndexProtocol::Response decoded;
+        QVERIFY(IndexProtocol::decodeResponse(payload, decoded));
+        QVERIFY(decoded.results.size() > 0);
+        QVERIFY(decoded.results.size() < response.results.size());
+        QCOMPARE(decoded.results.last().url, response.results.at(decoded.results.size() - 1).url);
+    }
+
+    /**
+     * 0 means all matches to BookmarkSearch, the daemon answers with the default number instead
+     */
+    void testDefaultLimit()
+    {
+        IndexClient client(m_socketPath);
+        IndexProtocol::Response response;
+        bool ok = false;
+        runClient([&]() {
+            ok = client.query(QStringLiteral("item"), 0, response);
+        });
+        QVERIFY(ok);
+        QCOMPARE(response.status, IndexProtocol::Status::Ok);
+        QVERIFY(bookmarkCount > IndexProtocol::DefaultLimit);
+        QCOMPARE(response.results.size(), IndexProtocol::DefaultLimit);
+
+        const IndexProtocol::Response clamped = m_server.answer(IndexProtocol::Request{IndexProtocol::RequestType::Query, 60000, QStringLiteral("item")});
+        QCOMPARE(clamped.results.size(), std::min(bookmarkCount, IndexProtocol::MaxLimit));
+    }
+
+    void testQuery()
+    {
+        const auto index = m_updater.acquire();
+        const QVector<SearchResult> expected = BookmarkSearch::search(*index, QStringLiteral("item 4"));
+        QVERIFY(expected.size() > 20);
+
+        IndexClient client(m_socketPath);
+        IndexProtocol::Response response;
+        bool ok = false;
+        runClient([&]() {
+            ok = client.query(QStringLiteral("item 4"), 20, response);
+        });
+        QVERIFY(ok);
+        QCOMPARE(response.generation, index->generation);
+        QCOMPARE(response.results.size(), 20);
+        for (int i = 0; i < response.results.size(); ++i) {
+            QCOMPARE(response.results.at(i).text, expected.at(i).bookmark->displayText);
+            QCOMPARE(response.results.at(i).url, expected.at(i).bookmark->url);
+            QCOMPARE(response.results.at(i).relevance, expected.at(i).relevance);
+        }
+    }
+
+    /**
+     * Folders come in front of the bookmarks, like in the runner, with the URLs of all their bookmarks
+     */
+    void testFolderQuery()
+    {
+        const auto index = m_updater.acquire();
+        const QString filter = QStringLiteral("folder:toolbar");
+        const QVector<FolderResult> folders = BookmarkSearch::folderSearch(*index, BookmarkQuery::parse(filter), IndexProtocol::MaxFolderResults);
+        QCOMPARE(folders.size(), 1);
+
+        IndexClient client(m_socketPath);
+        IndexProtocol::Response response;
+        bool ok = false;
+        runClient([&]() {
+            ok = client.query(filter, 20, response);
+        });
+        QVERIFY(ok);
+        QCOMPARE(response.results.size(), 1 + 20);
+        const IndexProtocol::Result &folder = response.results.first();
+        QCOMPARE(folder.kind, IndexProtocol::ResultKind::Folder);
+        QCOMPARE(folder.text, folders.first().text());
+        QCOMPARE(folder.urls, folders.first().urls());
+        QCOMPARE(folder.urls.size(), bookmarkCount);
+        QCOMPARE(response.results.at(1).kind, IndexProtocol::ResultKind::Bookmark);
+    }
+
+    void testFallbackWithoutDaemon()
+    {
+        IndexClient client(m_dir.filePath(QStringLiteral("missing.sock")));
+        IndexProtocol::Response response;
+        QElapsedTimer timer;
+        timer.start();
+        QVERIFY(!client.query(QStringLiteral("item"), 20, response));
+        QVERIFY(timer.elapsed() < IndexClient::TimeoutMs);
+        QCOMPARE(client.failures(), quint64(1));
+        // The next queries fall back right away instead of trying to connect again
+        QVERIFY(!client.query(QStringLiteral("item"), 20, response));
+        QCOMPARE(client.queries(), quint64(1));
+        QVERIFY(!client.isAvailable());
+        QCOMPARE(client.failures(), quint64(1));
+    }
+
+    /**
+     * KRunner checks the daemon whenever it is opened, a failed check has to start the retry interval as well
+     */
+    void testAvailabilityBackoff()
+    {
+        IndexClient client(m_dir.filePath(QStringLiteral("missing.sock")));
+        QVERIFY(!client.isAvailable());
+        QCOMPARE(client.failures(), quint64(1));
+        QVERIFY(!client.isAvailable());
+        QCOMPARE(client.failures(), quint64(1));
+        IndexProtocol::Response response;
+        QVERIFY(!client.query(QStringLiteral("item"), 20, response));
+        QCOMPARE(client.queries(), quint64(0));
+
+        IndexClient running(m_socketPath);
+        QVERIFY(running.isAvailable());
+        QCOMPARE(running.failures(), quint64(0));
+    }
+
+    /**
+     * The runner does not load its own index while the daemon answers. The icons of the results are prefetched,
+     * so that the next query for them shows them.
+     */
+    void testDaemonMatchIcons()
+    {
+        ZenBookmarkRunner runner(nullptr, KPluginMetaData(), QVariantList());
+        runner.reloadConfiguration();
+        runner.useIndexDaemon = true;
+        const auto iconsOfMatches = [&runner]() {
+            RunnerContext context;
+            context.setQuery(QStringLiteral("b item 4"));
+            runClient([&]() {
+                runner.match(context);
+            });
+            QVector<bool> icons;
+            for (const QueryMatch &match : context.matches()) {
+                icons.append(!match.icon().isNull());
+            }
+            return icons;
+        };
+
+        const QVector<bool> first = iconsOfMatches();
+        QCOMPARE(first.size(), ZenBookmarkRunner::MaxBookmarkMatches);
+        QVERIFY(std::none_of(first.cbegin(), first.cend(), [](bool icon) {
+            return icon;
+        }));
+        runner.waitForBackgroundWork();
+        const QVector<bool> second = iconsOfMatches();
+        QCOMPARE(second.size(), first.size());
+        QVERIFY(std::all_of(second.cbegin(), second.cend(), [](bool icon) {
+            return icon;
+        }));
+        QCOMPARE(runner.indexClient.queries(), quint64(2));
+        QCOMPARE(runner.indexClient.failures(), quint64(0));
+        QCOMPARE(runner.collectStats().value(QStringLiteral("indexEntries")).toInt(), 0);
+    }
+
+    /**
+     * A folder match of the daemon opens the whole folder, like one of the own index
+     */
+    void testDaemonFolderMatches()
+    {
+        ZenBookmarkRunner runner(nullptr, KPluginMetaData(), QVariantList());
+        runner.reloadConfiguration();
+        runner.useIndexDaemon = true;
+        RunnerContext context;
+        context.setQuery(QStringLiteral("b folder:toolbar"));
+        runClient([&]() {
+            runner.match(context);
+        });
+        QCOMPARE(runner.indexClient.failures(), quint64(0));
+        const QList<QueryMatch> matches = context.matches();
+        const auto folder = std::find_if(matches.cbegin(), matches.cend(), [](const QueryMatch &match) {
+            return match.data().userType() == QMetaType::QStringList;
+        });
+        QVERIFY(folder != matches.cend());
+        QCOMPARE(MatchPayload::urls(folder->data(), nullptr).size(), bookmarkCount);
+        QCOMPARE(matches.size(), 1 + ZenBookmarkRunner::MaxBookmarkMatches);
+    }
+
+    void testRoundTripLatency()
+    {
+        IndexClient client(m_socketPath);
+        QVector<qint64> latencies;
+        bool ok = true;
+        runClient([&]() {
+            for (int i = 0; i < 200 && ok; ++i) {
+                IndexProtocol::Response response;
+                QElapsedTimer timer;
+                timer.start();
+                ok = client.query(QStringLiteral("item %1").arg(i % 10), 20, response) && response.results.size() == 20;
+                latencies.append(timer.nsecsElapsed() / 1000);
+            }
+        });
+        QVERIFY(ok);
+        std::sort(latencies.begin(), latencies.end());
+        const qint64 median = latencies.at(latencies.size() / 2);
+        qDebug() << "Round trip median" << median << "us, p90" << latencies.at(latencies.size() * 9 / 10) << "us";
+        QVERIFY2(median < 1000, qPrintable(QStringLiteral("Median round trip of %1 us").arg(median)));
+    }
+
+    void testSecondDaemonRefused()
+    {
+        IndexServer second(m_updater);
+        QVERIFY(!second.listen(m_socketPath));
+        // The socket of the first one still works
+        IndexClient client(m_socketPath);
+        IndexProtocol::Response response;
+        bool ok = false;
+        runClient([&]() {
+            ok = client.query(QStringLiteral("item"), 1, response);
+        });
+        QVERIFY(ok);
+    }
+};
+
+QTEST_MAIN(IndexServiceTest)
+
+#include "IndexServiceTest.moc"
@@ -0,0 +1,90 @@
+#include "CountingHooks.h"
+#include "TestIndex.h"
+#include "bookmarks/BookmarkSearch.h"
+#include "bookmarks/MatchPayload.h"
+#include "firefoxprofilerunner.h"
+#include <KPluginMetaData>
+#include <QPixmap>
+#include <QTest>
+
+class MatchPayloadTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    // The shared data of the QueryMatch, its lock on KF5 and the match id KRunner derives from the data when the
+    // runner has no id, as in this test. Building the text or copying the URL per match would add to these.
+    static constexpr quint64 AllocationsPerMatch = 4;
+
+private Q_SLOTS:
+    /**
+     * The text and data of the matches are shared with the index instead of being built per match, what is left
+     * is the QueryMatch itself
+     */
+    static void testMatchesDoNotCopyPayload()
+    {
+        if (!CountingHooks::isSupported()) {
+            QSKIP("The counting hooks need glibc");
+        }
+        const BookmarkIndex index = TestIndex::numbered(100);
+        BookmarkSearch::Results results;
+        BookmarkSearch::search(index, BookmarkQuery::parse(QStringLiteral("bookmark")), results, ZenBookmarkRunner::MaxBookmarkMatches);
+        QCOMPARE(int(results.size()), ZenBookmarkRunner::MaxBookmarkMatches);
+
+        ZenBookmarkRunner runner(nullptr, KPluginMetaData(), QVariantList());
+        QPixmap pixmap(16, 16);
+        pixmap.fill(Qt::blue);
+        const QIcon icon(pixmap);
+        QList<QueryMatch> matches;
+        matches.reserve(int(results.size()) + 1);
+        // The first match of a runner sets up the guarded pointer to it
+        matches.append(runner.createMatch(QStringLiteral("warm up"), QVariant(), 0, icon));
+        matches.clear();
+
+        CountingHooks::start();
+        for (const SearchResult &result : results) {
+            matches.append(runner.createMatch(result.bookmark->displayText, MatchPayload::forBookmark(*result.bookmark), result.relevance, icon));
+        }
+        const CountingHooks::Counts counts = CountingHooks::stop();
+
+        qDebug() << counts.allocations << "allocations for" << matches.size() << "matches";
+        QVERIFY2(counts.allocations <= AllocationsPerMatch * quint64(matches.size()),
+                 qPrintable(QStringLiteral("%1 allocations for %2 matches, the budget is %3 per match")
+                                .arg(counts.allocations)
+                                .arg(matches.size())
+                                .arg(AllocationsPerMatch)));
+        QCOMPARE(matches.first().text(), results.front().bookmark->title + " - " + results.front().bookmark->url);
+        QCOMPARE(matches.first().data().toLongLong(), results.front().bookmark->id);
+    }
+
+    /**
+     * run() resolves the URL from the snapshot, removed bookmarks resolve to nothing
+     */
+    static void testResolveUrl()
+    {
+        BookmarkIndex index = TestIndex::numbered(100);
+        const QVariant data = MatchPayload::forBookmark(*index.find(42));
+        QCOMPARE(MatchPayload::url(data, &index), "https://example.com/42");
+        QCOMPARE(MatchPayload::url(MatchPayload::forUrl("https://kde.org/"), &index), "https://kde.org/");
+
+        index.remove(42);
+        QVERIFY(MatchPayload::url(data, &index).isEmpty());
+        QVERIFY(MatchPayload::url(data, nullptr).isEmpty());
+    }
+
+    /**
+     * Folders carry their URLs, they are opened even if the index was released since
+     */
+    static void testResolveFolderUrls()
+    {
+        const BookmarkIndex index = TestIndex::numbered(100);
+        const QStringList urls{QStringLiteral("https://example.com/1"), QStringLiteral("https://example.com/2")};
+        QCOMPARE(MatchPayload::urls(MatchPayload::forUrls(urls), nullptr), urls);
+        QCOMPARE(MatchPayload::urls(MatchPayload::forBookmark(*index.find(7)), &index), QStringList{"https://example.com/7"});
+        QVERIFY(MatchPayload::urls(MatchPayload::forBookmark(*index.find(7)), nullptr).isEmpty());
+    }
+};
+
+QTEST_MAIN(MatchPayloadTest)
+
+#include "MatchPayloadTest.moc"
@@ -0,0 +1,92 @@
+#include "tabs/OpenTabs.h"
+#include <QTest>
+
+class OpenTabsTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    /**
+     * mozLz4 file with the data stored as a single literal run, which is a valid LZ4 block
+     */
+    static QByteArray mozLz4Literals(const QByteArray &data)
+    {
+        QByteArray file("mozLz40", 8);
+        const quint32 size = data.size();
+        for (int i = 0; i < 4; ++i) {
+            file.append(char(size >> (8 * i) & 0xFF));
+        }
+        if (data.size() < 15) {
+            file.append(char(data.size() << 4));
+        } else {
+            file.append(char(0xF0));
+            int remaining = data.size() - 15;
+            for (; remaining >= 255; remaining -= 255) {
+                file.append(char(0xFF));
+            }
+            file.append(char(remaining));
+        }
+        return file + data;
+    }
+
+private Q_SLOTS:
+    static void testDecompress()
+    {
+        const QByteArray json = R"({"windows":[]})" + QByteArray(300, ' ');
+        QCOMPARE(OpenTabs::decompress(mozLz4Literals(json)), json);
+
+        // "abc" followed by a match of 9 bytes at offset 3 and the literal "X"
+        const QByteArray overlapping = QByteArray("mozLz40\0\x0d\0\0\0", 12) + QByteArray("\x35" "abc" "\x03\x00" "\x10" "X", 8);
+        QCOMPARE(OpenTabs::decompress(overlapping), QByteArray("abcabcabcabcX"));
+
+        QVERIFY(OpenTabs::decompress("not mozLz4").isNull());
+        // The match points before the start of the output
+        QVERIFY(OpenTabs::decompress(QByteArray("mozLz40\0\x10\0\0\0", 12) + QByteArray("\x10" "a" "\x05\x00", 4)).isNull());
+        // Truncated
+        QVERIFY(OpenTabs::decompress(mozLz4Literals(json).chopped(10)).isNull());
+    }
+
+    /**
+     * Only the current history entry of open tabs is used, closed tabs and windows are skipped
+     */
+    static void testParseSession()
+    {
+        const QByteArray json = R"({
+            "windows": [{
+                "tabs": [
+                    {"entries": [{"url": "https://a.example/", "title": "A"}, {"url": "https://kde.org/", "title": "KDE é"}],
+                     "index": 2, "zenWorkspace": "{w1}", "formdata": {"id": {"q": "]}"}}},
+                    {"entries": [{"url": "https://github.com/", "title": null}], "index": 1}
+                ],
+                "_closedTabs": [{"state": {"entries": [{"url": "https://closed.example/"}]}}],
+                "spaces": [{"uuid": "{w1}", "name": "Work"}]
+            }],
+            "_closedWindows": [{"tabs": [{"entries": [{"url": "https://closed-window.example/"}]}]}]
+        })";
+        const OpenTabs::TabList tabs = OpenTabs::parseSession(json);
+        QCOMPARE(tabs.size(), 2);
+        QCOMPARE(tabs.at(0).url, "https://kde.org/");
+        QCOMPARE(tabs.at(0).title, QStringLiteral("KDE é"));
+        QCOMPARE(tabs.at(0).workspace, "Work");
+        QCOMPARE(tabs.at(1).title, "https://github.com/");
+        QVERIFY(tabs.at(1).workspace.isEmpty());
+
+        const QVector<TabResult> results = OpenTabs::search(tabs, "kde");
+        QCOMPARE(results.size(), 1);
+        QCOMPARE(results.first().tab->url, "https://kde.org/");
+    }
+
+    static void testParseQuery()
+    {
+        QString filter;
+        QVERIFY(OpenTabs::parseQuery("t github", filter));
+        QCOMPARE(filter, "github");
+        QVERIFY(OpenTabs::parseQuery("tabs", filter));
+        QVERIFY(filter.isEmpty());
+        QVERIFY(!OpenTabs::parseQuery("test", filter));
+    }
+};
+
+QTEST_MAIN(OpenTabsTest)
+
+#include "OpenTabsTest.moc"
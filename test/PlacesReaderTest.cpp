@@ -0,0 +1,175 @@
+#include "bookmarks/BookmarkSearch.h"
+#include "bookmarks/PlacesDatabase.h"
+#include "bookmarks/PlacesReader.h"
+#include <QProcess>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QTest>
+
+static constexpr int bookmarkCount = 100000;
+
+/**
+ * The parallel full load against the serial one on a profile of places_writer with folders, tags and keywords
+ */
+class PlacesReaderTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static bool addStructure(const QString &path)
+    {
+        bool ok = true;
+        {
+            QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), QStringLiteral("places_reader_fixture"));
+            db.setDatabaseName(path);
+            QSqlQuery query(db);
+            const QStringList statements{
+                // As in Firefox, without them the tag lookups scan the whole table for every bookmark
+                QStringLiteral("CREATE INDEX moz_bookmarks_itemindex ON moz_bookmarks (fk)"),
+                QStringLiteral("CREATE INDEX moz_bookmarks_parentindex ON moz_bookmarks (parent, position)"),
+                QStringLiteral("CREATE TABLE moz_keywords (id INTEGER PRIMARY KEY, keyword TEXT, place_id INTEGER, post_data TEXT)"),
+                QStringLiteral("INSERT INTO moz_keywords (keyword, place_id) VALUES ('gh', (SELECT MIN(fk) FROM moz_bookmarks WHERE parent = 2))"),
+                QStringLiteral("INSERT INTO moz_bookmarks (parent, guid, title, lastModified) VALUES (1, 'tags________', '', 0)"),
+                QStringLiteral("INSERT INTO moz_bookmarks (parent, guid, title, lastModified) "
+                               "SELECT id, 'tag_rust', 'rust', 0 FROM moz_bookmarks WHERE guid = 'tags________'"),
+                QStringLiteral("INSERT INTO moz_bookmarks (parent, guid, title, lastModified) "
+                               "SELECT id, 'tag_work', 'work', 0 FROM moz_bookmarks WHERE guid = 'tags________'"),
+                QStringLiteral("INSERT INTO moz_bookmarks (fk, parent, guid, title, lastModified) "
+                               "SELECT fk, (SELECT id FROM moz_bookmarks WHERE guid = 'tag_rust'), 'rust' || id, NULL, 1 FROM moz_bookmarks "
+                               "WHERE parent = 2 AND id % 7 = 0"),
+                QStringLiteral("INSERT INTO moz_bookmarks (fk, parent, guid, title, lastModified) "
+                               "SELECT fk, (SELECT id FROM moz_bookmarks WHERE guid = 'tag_work'), 'work' || id, NULL, 1 FROM moz_bookmarks "
+                               "WHERE parent = 2 AND id % 11 = 0"),
+                QStringLiteral("INSERT INTO moz_bookmarks (parent, guid, title, lastModified) VALUES (1, 'folder_oncal', 'Oncall', 0)"),
+                QStringLiteral("INSERT INTO moz_bookmarks (parent, guid, title, lastModified) VALUES (1, 'folder_readi', 'Reading', 0)"),
+                QStringLiteral("UPDATE moz_bookmarks SET parent = (SELECT id FROM moz_bookmarks WHERE guid = 'folder_oncal'), position = id % 100 "
+                               "WHERE parent = 2 AND id % 5 = 0"),
+                QStringLiteral("UPDATE moz_bookmarks SET parent = (SELECT id FROM moz_bookmarks WHERE guid = 'folder_readi'), position = id % 100 "
+                               "WHERE parent = 2 AND id % 5 = 1"),
+                QStringLiteral("UPDATE moz_bookmarks SET position = id WHERE position IS NULL"),
+                // Neither is searchable
+                QStringLiteral("UPDATE moz_bookmarks SET title = '' WHERE parent = 2 AND id % 13 = 0"),
+                QStringLiteral("DELETE FROM moz_places WHERE id IN (SELECT fk FROM moz_bookmarks WHERE parent = 2 AND id % 17 = 0)"),
+            };
+            ok = db.open();
+            for (const QString &statement : statements) {
+                if (ok && !query.exec(statement)) {
+                    qWarning() << statement << query.lastError().text();
+                    ok = false;
+                }
+            }
+            db.close();
+        }
+        QSqlDatabase::removeDatabase(QStringLiteral("places_reader_fixture"));
+        return ok;
+    }
+
+    static void compareBookmarks(const Bookmark &actual, const Bookmark &expected)
+    {
+        QCOMPARE(actual.guid, expected.guid);
+        QCOMPARE(actual.title, expected.title);
+        QCOMPARE(actual.url, expected.url);
+        QCOMPARE(actual.lastModified, expected.lastModified);
+        QCOMPARE(actual.lastVisitDate, expected.lastVisitDate);
+        QCOMPARE(actual.frecency, expected.frecency);
+        QCOMPARE(actual.placeId, expected.placeId);
+        QCOMPARE(actual.folder, expected.folder);
+        QCOMPARE(actual.folderId, expected.folderId);
+        QCOMPARE(actual.position, expected.position);
+        QStringList actualTags = actual.tags;
+        QStringList expectedTags = expected.tags;
+        actualTags.sort();
+        expectedTags.sort();
+        QCOMPARE(actualTags, expectedTags);
+        QCOMPARE(actual.displayText, expected.displayText);
+        QCOMPARE(actual.foldedTitle, expected.foldedTitle);
+        QCOMPARE(actual.host, expected.host);
+        QCOMPARE(actual.words, expected.words);
+        QCOMPARE(actual.urlTokens.size(), expected.urlTokens.size());
+    }
+
+    static QList<qint64> ids(const QVector<SearchResult> &results)
+    {
+        QList<qint64> ids;
+        for (const SearchResult &result : results) {
+            ids.append(result.bookmark->id);
+        }
+        return ids;
+    }
+
+    QTemporaryDir m_dir;
+    QString m_path;
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(m_dir.isValid());
+        m_path = m_dir.filePath(QStringLiteral("places.sqlite"));
+        QCOMPARE(QProcess::execute(QStringLiteral(PLACES_WRITER_EXECUTABLE), {QStringLiteral("init"), m_path, QString::number(bookmarkCount)}), 0);
+        QVERIFY(addStructure(m_path));
+    }
+
+    void testParallelMatchesSerial()
+    {
+        PlacesDatabase places(m_path, QStringLiteral("places_reader_"));
+        QVERIFY(places.open());
+        BookmarkIndex serial;
+        QVERIFY(PlacesReader(places.database()).readAll(serial));
+        BookmarkIndex parallel;
+        PlacesReader::BuildStats build;
+        QVERIFY(PlacesReader::readAllParallel(places, parallel, &build));
+        qDebug() << "Parallel load of" << parallel.size() << "bookmarks in" << build.totalUs << "us, reading" << build.readUs << "us, preparing"
+                 << build.prepareUs << "us, inserting" << build.insertUs << "us";
+        QCOMPARE(build.totalUs, build.readUs + build.prepareUs + build.insertUs);
+
+        QVERIFY(serial.size() > bookmarkCount * 8 / 10);
+        QVERIFY(serial.size() < bookmarkCount);
+        QCOMPARE(parallel.size(), serial.size());
+        for (const Bookmark &expected : serial.bookmarks()) {
+            const Bookmark *actual = parallel.find(expected.id);
+            QVERIFY(actual);
+            compareBookmarks(*actual, expected);
+            if (QTest::currentTestFailed()) {
+                return;
+            }
+        }
+        QCOMPARE(parallel.modifiedWatermark, serial.modifiedWatermark);
+        QCOMPARE(parallel.visitWatermark, serial.visitWatermark);
+        QCOMPARE(parallel.removedWatermark, serial.removedWatermark);
+        QCOMPARE(parallel.keywords().keys(), QStringList{QStringLiteral("gh")});
+        QCOMPARE(parallel.keywords(), serial.keywords());
+
+        QVERIFY(!parallel.wordStarts().isEmpty());
+        QCOMPARE(parallel.wordStarts().memoryUsage(), serial.wordStarts().memoryUsage());
+        QVERIFY(!parallel.idsWithTag(QStringLiteral("rust")).isEmpty());
+        QCOMPARE(parallel.idsWithTag(QStringLiteral("work")), serial.idsWithTag(QStringLiteral("work")));
+        QCOMPARE(parallel.idsInFolder(QStringLiteral("oncall")), serial.idsInFolder(QStringLiteral("oncall")));
+        for (const QString &filter : {QStringLiteral("tag:rust item 12"), QStringLiteral("folder:reading 77"), QStringLiteral("example 4242")}) {
+            QCOMPARE(ids(BookmarkSearch::search(parallel, filter)), ids(BookmarkSearch::search(serial, filter)));
+        }
+    }
+
+    void benchmarkBuild_data()
+    {
+        QTest::addColumn<bool>("parallel");
+        QTest::newRow("serial") << false;
+        QTest::newRow("parallel") << true;
+    }
+
+    void benchmarkBuild()
+    {
+        QFETCH(bool, parallel);
+        PlacesDatabase places(m_path, QStringLiteral("places_reader_"));
+        QVERIFY(places.open());
+        QBENCHMARK {
+            BookmarkIndex index;
+            QVERIFY(parallel ? PlacesReader::readAllParallel(places, index) : PlacesReader(places.database()).readAll(index));
+        }
+    }
+};
+
+QTEST_GUILESS_MAIN(PlacesReaderTest)
+
+#include "PlacesReaderTest.moc"
@@ -0,0 +1,283 @@
+#include "bookmarks/PlacesDatabase.h"
+#include "firefoxprofilerunner.h"
+#include <KPluginMetaData>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QSqlDatabase>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static const QString connectionPrefix = QStringLiteral("places_stress_");
+// Snapshots and connections of the runner: the index, its parallel build and the favicon prefetch
+static const QString runnerPrefix = QStringLiteral("zen_");
+static const QString query = QStringLiteral("b item");
+static constexpr int bookmarkCount = 500;
+static constexpr int readerThreads = 8;
+static constexpr int writeDurationMs = 3000;
+
+/**
+ * Concurrent match() calls on the runner, the way KRunner runs them on its worker threads, while the
+ * places_writer process modifies and checkpoints places.sqlite
+ */
+class PlacesStressTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    struct Reader {
+        qint64 generation = 0;
+        int reads = 0;
+        QStringList errors;
+        QVector<qint64> latencies; // Microseconds
+    };
+
+    /**
+     * The matches of one query come from a single generation of the index, which is not older than the
+     * one of the previous query of the reader. Every generation has enough bookmarks to fill the matches.
+     */
+    static QString checkMatches(const QList<QueryMatch> &matches, qint64 &generation)
+    {
+        static const QRegularExpression text(QStringLiteral("^Item \\d+ gen (\\d+) - "));
+        if (matches.size() != ZenBookmarkRunner::MaxBookmarkMatches) {
+            return QStringLiteral("Expected %1 matches, got %2").arg(ZenBookmarkRunner::MaxBookmarkMatches).arg(matches.size());
+        }
+        qint64 current = -1;
+        for (const QueryMatch &match : matches) {
+            const QRegularExpressionMatch textMatch = text.match(match.text());
+            if (!textMatch.hasMatch()) {
+                return QStringLiteral("Unexpected match ") + match.text();
+            }
+            const qint64 matchGeneration = textMatch.captured(1).toLongLong();
+            if (current != -1 && matchGeneration != current) {
+                return QStringLiteral("Torn read, generations %1 and %2").arg(current).arg(matchGeneration);
+            }
+            current = matchGeneration;
+        }
+        if (current < generation) {
+            return QStringLiteral("Generation went back from %1 to %2").arg(generation).arg(current);
+        }
+        generation = current;
+        return QString();
+    }
+
+    /**
+     * One query, its match() schedules a refresh if the writer changed the database meanwhile
+     */
+    void read(Reader &reader)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        RunnerContext context;
+        context.setQuery(query);
+        m_runner->match(context);
+        reader.latencies.append(timer.nsecsElapsed() / 1000);
+        const QString error = checkMatches(context.matches(), reader.generation);
+        if (!error.isEmpty()) {
+            reader.errors.append(error);
+        }
+        ++reader.reads;
+    }
+
+    void runReaders(std::vector<Reader> &readers, const std::function<bool(const Reader &)> &keepReading)
+    {
+        std::vector<std::thread> threads;
+        for (Reader &reader : readers) {
+            threads.emplace_back([this, &reader, &keepReading]() {
+                while (keepReading(reader)) {
+                    read(reader);
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
+    static qint64 percentile(const std::vector<Reader> &readers, double fraction)
+    {
+        QVector<qint64> latencies;
+        for (const Reader &reader : readers) {
+            latencies.append(reader.latencies);
+        }
+        if (latencies.isEmpty()) {
+            return 0;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        return latencies.at(std::min<qsizetype>(latencies.size() - 1, qsizetype(latencies.size() * fraction)));
+    }
+
+    static qint64 lastGeneration(const std::vector<Reader> &readers)
+    {
+        qint64 generation = 0;
+        for (const Reader &reader : readers) {
+            generation = std::max(generation, reader.generation);
+        }
+        return generation;
+    }
+
+    QTemporaryDir m_home;
+    QString m_path;
+    std::unique_ptr<ZenBookmarkRunner> m_runner;
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+        QVERIFY(m_home.isValid());
+        // The runner finds the profile below the home directory
+        qputenv("HOME", QFile::encodeName(m_home.path()));
+        const QString profile = m_home.filePath(QStringLiteral(".var/app/app.zen_browser.zen/.zen/cr6uussi.Default (release)"));
+        QVERIFY(QDir().mkpath(profile));
+        m_path = profile + QStringLiteral("/places.sqlite");
+        QCOMPARE(QProcess::execute(QStringLiteral(PLACES_WRITER_EXECUTABLE), {QStringLiteral("init"), m_path, QString::number(bookmarkCount)}), 0);
+
+        m_runner = std::make_unique<ZenBookmarkRunner>(nullptr, KPluginMetaData(), QVariantList());
+        m_runner->reloadConfiguration();
+        QCOMPARE(m_runner->zenBookmarksPath, m_path);
+        m_runner->warmUp();
+        m_runner->waitForBackgroundWork();
+        QCOMPARE(m_runner->collectStats().value(QStringLiteral("indexEntries")).toInt(), bookmarkCount);
+    }
+
+    void cleanupTestCase()
+    {
+        m_runner.reset();
+    }
+
+    void testSnapshotReuse()
+    {
+        // The snapshot of the runner is kept for its next refresh
+        PlacesDatabase::releaseSnapshots();
+        const PlacesDatabase::Stats before = PlacesDatabase::stats();
+        {
+            PlacesDatabase first(m_path, connectionPrefix);
+            QVERIFY(first.open());
+            PlacesDatabase second(m_path, connectionPrefix);
+            QVERIFY(second.open());
+        }
+        // The source did not change, the second open and this one use the same snapshot
+        PlacesDatabase third(m_path, connectionPrefix);
+        QVERIFY(third.open());
+        const PlacesDatabase::Stats after = PlacesDatabase::stats();
+        QCOMPARE(after.snapshots, before.snapshots + 1);
+        QCOMPARE(after.reuses, before.reuses + 2);
+        const qint64 sourceSize = QFileInfo(m_path).size() + QFileInfo(m_path + QStringLiteral("-wal")).size();
+        QCOMPARE(after.bytesCloned + after.bytesCopied - before.bytesCloned - before.bytesCopied, quint64(sourceSize));
+    }
+
+    /**
+     * Snapshots of a process that was killed are removed by the first snapshot with their prefix
+     */
+    void testStaleSnapshotsRemoved()
+    {
+        const QString prefix = QStringLiteral("places_stale_");
+        const QDir directory(PlacesDatabase::snapshotDirectories().constLast());
+        // Above the highest possible PID
+        const QString stale = directory.filePath(prefix + QStringLiteral("2147483647_0.sqlite"));
+        const QString own = directory.filePath(prefix + QStringLiteral("%1_999999.sqlite").arg(QCoreApplication::applicationPid()));
+        for (const QString &path : {stale, stale + QStringLiteral("-wal"), own}) {
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+        }
+
+        // The cleanup runs when a snapshot is made, not when the current one is reused
+        PlacesDatabase::releaseSnapshots();
+        {
+            PlacesDatabase places(m_path, prefix);
+            QVERIFY(places.open());
+        }
+        QVERIFY(!QFile::exists(stale));
+        QVERIFY(!QFile::exists(stale + QStringLiteral("-wal")));
+        QVERIFY(QFile::exists(own));
+        QFile::remove(own);
+        PlacesDatabase::releaseSnapshots();
+    }
+
+    void testConcurrentWriter()
+    {
+        // Latency without a writer as reference
+        std::vector<Reader> baseline(readerThreads);
+        runReaders(baseline, [](const Reader &reader) {
+            return reader.latencies.size() < 100;
+        });
+        for (const Reader &reader : baseline) {
+            QVERIFY2(reader.errors.isEmpty(), qPrintable(reader.errors.join(QLatin1String(", "))));
+            QCOMPARE(reader.reads, 100);
+        }
+        const qint64 baselineGeneration = lastGeneration(baseline);
+        const quint64 patchesBefore = m_runner->collectStats().value(QStringLiteral("indexPatches")).toULongLong();
+
+        QProcess writer;
+        writer.start(QStringLiteral(PLACES_WRITER_EXECUTABLE), {QStringLiteral("write"), m_path, QString::number(writeDurationMs)});
+        QVERIFY(writer.waitForStarted());
+        std::atomic<bool> writing{true};
+        std::vector<Reader> readers(readerThreads);
+        std::thread readerThread([this, &readers, &writing]() {
+            runReaders(readers, [&writing](const Reader &) {
+                return writing.load();
+            });
+        });
+        const bool finished = writer.waitForFinished(writeDurationMs + 30000);
+        writing = false;
+        readerThread.join();
+
+        QVERIFY(finished);
+        QCOMPARE(writer.exitStatus(), QProcess::NormalExit);
+        QVERIFY2(writer.exitCode() == 0, writer.readAllStandardError().constData());
+        const int transactions = writer.readAllStandardOutput().trimmed().toInt();
+        QVERIFY(transactions > 0);
+
+        int reads = 0;
+        for (const Reader &reader : readers) {
+            QVERIFY2(reader.errors.isEmpty(), qPrintable(reader.errors.join(QLatin1String(", "))));
+            QVERIFY(reader.reads > 0);
+            reads += reader.reads;
+        }
+        // The writer pauses between bursts, the refreshes scheduled by the queries have to catch up then
+        m_runner->waitForBackgroundWork();
+        const quint64 patches = m_runner->collectStats().value(QStringLiteral("indexPatches")).toULongLong() - patchesBefore;
+        QVERIFY(patches > 0);
+        QVERIFY(lastGeneration(readers) > baselineGeneration);
+
+        const qint64 baselineLatency = percentile(baseline, 0.9);
+        const qint64 loadLatency = percentile(readers, 0.9);
+        qInfo() << transactions << "transactions," << reads << "queries," << patches << "index patches, p90 latency" << baselineLatency << "us idle"
+                << loadLatency << "us while writing";
+        // Queries never wait for a refresh or the database, a slow one means they are blocked by the writer
+        QVERIFY2(loadLatency <= 10 * baselineLatency + 50000, qPrintable(QStringLiteral("p90 latency %1 us").arg(loadLatency)));
+    }
+
+    /**
+     * Every copy and connection is removed again, including those of failed attempts
+     */
+    void testNoLeaks()
+    {
+        m_runner.reset();
+        PlacesDatabase::releaseSnapshots();
+        const QStringList directories = PlacesDatabase::snapshotDirectories();
+        for (const QString &directory : directories) {
+            const QStringList copies = QDir(directory).entryList({connectionPrefix + QLatin1Char('*'), runnerPrefix + QLatin1Char('*')}, QDir::Files);
+            QVERIFY2(copies.isEmpty(), qPrintable(directory + QLatin1String(": ") + copies.join(QLatin1String(", "))));
+        }
+        const QStringList connections =
+            QSqlDatabase::connectionNames().filter(QRegularExpression(QStringLiteral("^(%1|%2)").arg(connectionPrefix, runnerPrefix)));
+        QVERIFY2(connections.isEmpty(), qPrintable(connections.join(QLatin1String(", "))));
+    }
+};
+
+QTEST_MAIN(PlacesStressTest)
+
+#include "PlacesStressTest.moc"
@@ -0,0 +1,190 @@
+/**
+ * Stand-in for Zen writing to places.sqlite and favicons.sqlite, used by the tests that need a profile.
+ *
+ *   places_writer init <path> <count>     create a database with count bookmarks
+ *   places_writer write <path> <duration> modify it for duration ms
+ *   places_writer favicons <path> <places> create favicons.sqlite with an icon for every page of places
+ *
+ * Every transaction renames all bookmarks to "Item <id> gen <generation>" and replaces the oldest one,
+ * so a consistent read sees exactly count bookmarks of the same generation. The WAL is checkpointed
+ * regularly to move pages into the database while readers copy it.
+ */
+#include "favicons/MozHash.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTextStream>
+#include <QThread>
+#include <QVariant>
+
+// Longer URLs spread the bookmarks over more pages, a checkpoint then writes more of the database
+static const QString urlPadding = QString(200, QLatin1Char('x'));
+static constexpr int burstTransactions = 20;
+static constexpr int pauseMs = 100;
+
+static bool exec(QSqlQuery &query, const QString &statement)
+{
+    if (!query.exec(statement)) {
+        QTextStream(stderr) << statement << ": " << query.lastError().text() << Qt::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool insertBookmark(QSqlQuery &query, qint64 generation)
+{
+    if (!exec(query, QStringLiteral("INSERT INTO moz_places (url, last_visit_date, frecency) VALUES ('https://example.com/' || (SELECT IFNULL(MAX(id), 0) + 1 FROM moz_places) || '/%1', 0, 100)").arg(urlPadding))) {
+        return false;
+    }
+    return exec(query,
+                QStringLiteral("INSERT INTO moz_bookmarks (fk, parent, guid, title, lastModified) "
+                               "VALUES (last_insert_rowid(), 2, 'guid' || last_insert_rowid(), 'Item ' || last_insert_rowid() || ' gen %1', %1)")
+                    .arg(generation));
+}
+
+static int init(QSqlDatabase &db, int count)
+{
+    QSqlQuery query(db);
+    const QStringList statements{
+        QStringLiteral("PRAGMA journal_mode = WAL"),
+        QStringLiteral("PRAGMA wal_autocheckpoint = 0"),
+        QStringLiteral("CREATE TABLE moz_places (id INTEGER PRIMARY KEY, url TEXT, last_visit_date INTEGER, frecency INTEGER)"),
+        QStringLiteral("CREATE TABLE moz_bookmarks (id INTEGER PRIMARY KEY, fk INTEGER, parent INTEGER, position INTEGER, guid TEXT, title TEXT, lastModified INTEGER)"),
+        QStringLiteral("CREATE TABLE moz_bookmarks_deleted (guid TEXT PRIMARY KEY, dateRemoved INTEGER)"),
+        QStringLiteral("INSERT INTO moz_bookmarks (id, parent, guid, title, lastModified) VALUES (1, 0, 'root________', '', 0)"),
+        QStringLiteral("INSERT INTO moz_bookmarks (id, parent, guid, title, lastModified) VALUES (2, 1, 'toolbar_____', 'toolbar', 0)"),
+    };
+    for (const QString &statement : statements) {
+        if (!exec(query, statement)) {
+            return 1;
+        }
+    }
+    db.transaction();
+    for (int i = 0; i < count; ++i) {
+        if (!insertBookmark(query, 1)) {
+            return 1;
+        }
+    }
+    return db.commit() ? 0 : 1;
+}
+
+static int write(QSqlDatabase &db, int durationMs)
+{
+    QSqlQuery query(db);
+    if (!exec(query, QStringLiteral("PRAGMA journal_mode = WAL")) || !exec(query, QStringLiteral("PRAGMA wal_autocheckpoint = 0"))) {
+        return 1;
+    }
+    qint64 generation = 1;
+    if (exec(query, QStringLiteral("SELECT MAX(lastModified) FROM moz_bookmarks")) && query.next()) {
+        generation = query.value(0).toLongLong();
+    }
+    static const QStringList checkpoints{QStringLiteral("PASSIVE"), QStringLiteral("RESTART"), QStringLiteral("TRUNCATE")};
+
+    QElapsedTimer timer;
+    timer.start();
+    int transactions = 0;
+    while (timer.elapsed() < durationMs) {
+        ++generation;
+        db.transaction();
+        const bool ok = exec(query,
+                             QStringLiteral("INSERT INTO moz_bookmarks_deleted (guid, dateRemoved) "
+                                            "SELECT guid, %1 FROM moz_bookmarks WHERE id = (SELECT MIN(id) FROM moz_bookmarks WHERE parent = 2)")
+                                 .arg(generation))
+            && exec(query, QStringLiteral("DELETE FROM moz_places WHERE id = (SELECT fk FROM moz_bookmarks WHERE id = (SELECT MIN(id) FROM moz_bookmarks WHERE parent = 2))"))
+            && exec(query, QStringLiteral("DELETE FROM moz_bookmarks WHERE id = (SELECT MIN(id) FROM moz_bookmarks WHERE parent = 2)"))
+            && insertBookmark(query, generation)
+            && exec(query, QStringLiteral("UPDATE moz_bookmarks SET title = 'Item ' || fk || ' gen %1', lastModified = %1 WHERE parent = 2").arg(generation));
+        if (!ok || !db.commit()) {
+            return 1;
+        }
+        ++transactions;
+        if (transactions % 10 == 0 && !exec(query, QStringLiteral("PRAGMA wal_checkpoint(%1)").arg(checkpoints.at(transactions / 10 % checkpoints.size())))) {
+            return 1;
+        }
+        if (transactions % burstTransactions == 0) {
+            QThread::msleep(pauseMs);
+        }
+    }
+    QTextStream(stdout) << transactions << Qt::endl;
+    return 0;
+}
+
+// 1x1 RGBA PNG, decodable without any image plugin
+static const QByteArray iconData = QByteArray::fromHex(
+    "89504e470d0a1a0a0000000d49484452000000010000000108060000001f15c4890000000d49444154789c63b05df7f23f0005d402d4f2bd69e50000000049454e44ae426082");
+
+static int favicons(QSqlDatabase &db, const QString &placesPath)
+{
+    QStringList urls;
+    {
+        QSqlDatabase places = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), QStringLiteral("places"));
+        places.setDatabaseName(placesPath);
+        QSqlQuery query(places);
+        if (!places.open() || !exec(query, QStringLiteral("SELECT url FROM moz_places"))) {
+            return 1;
+        }
+        while (query.next()) {
+            urls.append(query.value(0).toString());
+        }
+    }
+    QSqlDatabase::removeDatabase(QStringLiteral("places"));
+
+    QSqlQuery query(db);
+    const QStringList statements{
+        QStringLiteral("CREATE TABLE moz_icons (id INTEGER PRIMARY KEY, icon_url TEXT, fixed_icon_url TEXT, width INTEGER, root INTEGER, data BLOB)"),
+        QStringLiteral("CREATE TABLE moz_pages_w_icons (id INTEGER PRIMARY KEY, page_url TEXT, page_url_hash INTEGER)"),
+        QStringLiteral("CREATE TABLE moz_icons_to_pages (page_id INTEGER, icon_id INTEGER)"),
+        QStringLiteral("CREATE INDEX moz_pages_w_icons_urlhashindex ON moz_pages_w_icons (page_url_hash)"),
+    };
+    for (const QString &statement : statements) {
+        if (!exec(query, statement)) {
+            return 1;
+        }
+    }
+    // Every page has an icon of its own, with the same id as the page
+    QSqlQuery iconQuery(db);
+    QSqlQuery pageQuery(db);
+    iconQuery.prepare(QStringLiteral("INSERT INTO moz_icons (id, icon_url, fixed_icon_url, width, root, data) VALUES (?, ?, ?, 16, 0, ?)"));
+    pageQuery.prepare(QStringLiteral("INSERT INTO moz_pages_w_icons (id, page_url, page_url_hash) VALUES (?, ?, ?)"));
+    db.transaction();
+    for (int i = 0; i < urls.size(); ++i) {
+        const QString &url = urls.at(i);
+        iconQuery.addBindValue(i + 1);
+        iconQuery.addBindValue(url + QStringLiteral("/favicon.png"));
+        iconQuery.addBindValue(url + QStringLiteral("/favicon.png"));
+        iconQuery.addBindValue(iconData);
+        pageQuery.addBindValue(i + 1);
+        pageQuery.addBindValue(url);
+        pageQuery.addBindValue(static_cast<qint64>(MozHash::hashUrl(url)));
+        if (!iconQuery.exec() || !pageQuery.exec()
+            || !exec(query, QStringLiteral("INSERT INTO moz_icons_to_pages (page_id, icon_id) VALUES (%1, %1)").arg(i + 1))) {
+            QTextStream(stderr) << iconQuery.lastError().text() << pageQuery.lastError().text() << Qt::endl;
+            return 1;
+        }
+    }
+    return db.commit() ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    const QStringList arguments = app.arguments();
+    const QStringList commands{QStringLiteral("init"), QStringLiteral("write"), QStringLiteral("favicons")};
+    if (arguments.size() != 4 || !commands.contains(arguments.at(1))) {
+        QTextStream(stderr) << "Usage: places_writer init|write|favicons <path> <count|duration|places>" << Qt::endl;
+        return 2;
+    }
+    QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"));
+    db.setDatabaseName(arguments.at(2));
+    if (!db.open()) {
+        QTextStream(stderr) << db.lastError().text() << Qt::endl;
+        return 1;
+    }
+    if (arguments.at(1) == QLatin1String("favicons")) {
+        return favicons(db, arguments.at(3));
+    }
+    const int value = arguments.at(3).toInt();
+    return arguments.at(1) == QLatin1String("init") ? init(db, value) : write(db, value);
+}
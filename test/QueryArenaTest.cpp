@@ -0,0 +1,104 @@
+#include "CountingAllocator.h"
+#include "TestIndex.h"
+#include "bookmarks/BookmarkSearch.h"
+#include "bookmarks/QueryArena.h"
+#include <QTest>
+
+#include <climits>
+#include <cstddef>
+
+class QueryArenaTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    /**
+     * Heap allocations of a search after the arena has seen a query of the same size
+     */
+    static int searchAllocations(const BookmarkIndex &index, const BookmarkQuery &query, std::size_t expectedResults)
+    {
+        for (int run = 0; run < 2; ++run) {
+            const int before = CountingAllocator::allocations();
+            {
+                QueryArena::Scope arenaScope;
+                BookmarkSearch::Results results(QueryArena::resource());
+                BookmarkSearch::search(index, query, results);
+                if (results.size() != expectedResults) {
+                    return -1;
+                }
+            }
+            if (run == 1) {
+                return CountingAllocator::allocations() - before;
+            }
+        }
+        return -1;
+    }
+
+private Q_SLOTS:
+    static void testScopeResets()
+    {
+        QueryArena &arena = QueryArena::local();
+        const quint64 resets = QueryArena::stats().resets;
+        {
+            QueryArena::Scope outer;
+            {
+                QueryArena::Scope inner;
+                std::pmr::vector<int> values(QueryArena::resource());
+                values.resize(100);
+            }
+            // Only the outermost scope resets, results of nested searches stay valid
+            QVERIFY(arena.used() >= 100 * sizeof(int));
+        }
+        QCOMPARE(arena.used(), std::size_t(0));
+        QCOMPARE(QueryArena::stats().resets, resets + 1);
+        QVERIFY(QueryArena::stats().highWaterBytes >= 100 * sizeof(int));
+    }
+
+    /**
+     * A query larger than the buffer falls back to the heap once, after that the buffer fits it
+     */
+    static void testGrowsToHighWater()
+    {
+        QueryArena &arena = QueryArena::local();
+        const std::size_t size = arena.capacity() * 3;
+        const quint64 overflows = QueryArena::stats().overflows;
+        {
+            QueryArena::Scope arenaScope;
+            std::pmr::vector<char> buffer(size, QueryArena::resource());
+        }
+        QCOMPARE(QueryArena::stats().overflows, overflows + 1);
+        QVERIFY(arena.capacity() >= size);
+
+        const int before = CountingAllocator::allocations();
+        {
+            QueryArena::Scope arenaScope;
+            std::pmr::vector<char> buffer(size, QueryArena::resource());
+        }
+        QCOMPARE(CountingAllocator::allocations() - before, 0);
+        QCOMPARE(QueryArena::stats().overflows, overflows + 1);
+    }
+
+    /**
+     * Candidates, scores and folded terms come from the arena, so the heap allocations of a search
+     * do not depend on the number of bookmarks
+     */
+    static void testSearchAllocationsDoNotScale()
+    {
+        const BookmarkIndex small = TestIndex::numbered(100);
+        const BookmarkIndex large = TestIndex::numbered(20000);
+        const BookmarkQuery query = BookmarkQuery::parse(QStringLiteral("bookmark"));
+        // Handing chunks to the thread pool allocates too, that is not what this is about
+        const int parallelThreshold = BookmarkSearch::parallelThreshold();
+        BookmarkSearch::setParallelThreshold(INT_MAX);
+
+        const int smallAllocations = searchAllocations(small, query, 100);
+        const int largeAllocations = searchAllocations(large, query, 20000);
+        BookmarkSearch::setParallelThreshold(parallelThreshold);
+        QVERIFY(smallAllocations >= 0);
+        QCOMPARE(largeAllocations, smallAllocations);
+    }
+};
+
+QTEST_GUILESS_MAIN(QueryArenaTest)
+
+#include "QueryArenaTest.moc"
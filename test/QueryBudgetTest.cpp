@@ -0,0 +1,159 @@
+#include "CountingHooks.h"
+#include "firefoxprofilerunner.h"
+#include <KPluginMetaData>
+#include <QDir>
+#include <QFile>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <algorithm>
+#include <memory>
+
+static constexpr int bookmarkCount = 2000;
+
+/**
+ * Allocations and file opens of match() on a fixture profile. After warmUp() the index is loaded and the icons
+ * of the most frecent bookmarks are prefetched, like with the shipped settings. A query must be answered from
+ * memory: no copies, no connections, no temp files, even if the icons of its results were never looked up.
+ */
+class QueryBudgetTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Parsing, searching and the debug output, independent of the number of bookmarks
+    static constexpr quint64 AllocationsPerQuery = 500;
+    // QueryMatch, its data and the bookkeeping of the RunnerContext
+    static constexpr quint64 AllocationsPerMatch = 24;
+
+    struct Measurement {
+        CountingHooks::Counts counts;
+        int matches = 0;
+        int icons = 0;
+    };
+
+    static quint64 allocationBudget(int matches)
+    {
+        return AllocationsPerQuery + AllocationsPerMatch * quint64(matches);
+    }
+
+    Measurement measure(const QString &query)
+    {
+        // The prefetch of the previous query is done, it must not be counted for this one
+        m_runner->waitForBackgroundWork();
+        RunnerContext context;
+        context.setQuery(query);
+        Measurement measurement;
+        {
+            // The query may schedule the prefetch of its icons, which opens favicons.sqlite on its own thread.
+            // It waits for running queries, this keeps it waiting until the counting stopped.
+            FaviconPrefetcher::QueryGuard prefetchGuard(m_runner->faviconPrefetcher);
+            CountingHooks::start();
+            m_runner->match(context);
+            measurement.counts = CountingHooks::stop();
+        }
+        const QList<QueryMatch> matches = context.matches();
+        measurement.matches = matches.size();
+        measurement.icons = std::count_if(matches.cbegin(), matches.cend(), [](const QueryMatch &match) {
+            return !match.icon().isNull();
+        });
+        return measurement;
+    }
+
+    static void verifyBudget(const QString &query, const Measurement &measurement)
+    {
+        qDebug() << query << "-" << measurement.counts.allocations << "allocations for" << measurement.matches << "matches";
+        QCOMPARE(measurement.counts.opens, quint64(0));
+        QCOMPARE(measurement.counts.creates, quint64(0));
+        QVERIFY2(measurement.counts.allocations < allocationBudget(measurement.matches),
+                 qPrintable(QStringLiteral("%1 allocations for \"%2\", the budget is %3")
+                                .arg(measurement.counts.allocations)
+                                .arg(query)
+                                .arg(allocationBudget(measurement.matches))));
+    }
+
+    QTemporaryDir m_home;
+    std::unique_ptr<ZenBookmarkRunner> m_runner;
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        if (!CountingHooks::isSupported()) {
+            QSKIP("The counting hooks need glibc");
+        }
+        QStandardPaths::setTestModeEnabled(true);
+        QVERIFY(m_home.isValid());
+        // The runner finds the profile below the home directory
+        qputenv("HOME", QFile::encodeName(m_home.path()));
+        const QString profile = m_home.filePath(QStringLiteral(".var/app/app.zen_browser.zen/.zen/cr6uussi.Default (release)"));
+        QVERIFY(QDir().mkpath(profile));
+        const QString placesPath = profile + QStringLiteral("/places.sqlite");
+        QCOMPARE(QProcess::execute(QStringLiteral(PLACES_WRITER_EXECUTABLE), {QStringLiteral("init"), placesPath, QString::number(bookmarkCount)}), 0);
+        QCOMPARE(QProcess::execute(QStringLiteral(PLACES_WRITER_EXECUTABLE), {QStringLiteral("favicons"), profile + QStringLiteral("/favicons.sqlite"), placesPath}),
+                 0);
+
+        m_runner = std::make_unique<ZenBookmarkRunner>(nullptr, KPluginMetaData(), QVariantList());
+        m_runner->reloadConfiguration();
+        QCOMPARE(m_runner->zenBookmarksPath, placesPath);
+        QVERIFY(m_runner->faviconPrefetcher.maxIcons < bookmarkCount);
+        m_runner->warmUp();
+        m_runner->waitForBackgroundWork();
+        QCOMPARE(m_runner->collectStats().value(QStringLiteral("indexEntries")).toInt(), bookmarkCount);
+    }
+
+    void cleanupTestCase()
+    {
+        m_runner.reset();
+    }
+
+    static void testWarmQuery_data()
+    {
+        QTest::addColumn<QString>("query");
+        QTest::newRow("word starts") << QStringLiteral("b it");
+        QTest::newRow("terms") << QStringLiteral("b item 12");
+        QTest::newRow("url") << QStringLiteral("b example 7");
+        QTest::newRow("operators") << QStringLiteral("b site:example.com -gen2 item");
+        QTest::newRow("typo") << QStringLiteral("b iteem 5");
+    }
+
+    /**
+     * The same query again, e.g. when KRunner is opened with the previous query. The first run initializes
+     * statics like the regular expressions of the parser and has the missing icons prefetched.
+     */
+    void testWarmQuery()
+    {
+        QFETCH(QString, query);
+        QVERIFY(measure(query).matches > 0);
+        const Measurement measurement = measure(query);
+        verifyBudget(query, measurement);
+        QCOMPARE(measurement.icons, measurement.matches);
+    }
+
+    /**
+     * Typing a query, every keystroke is a new query with other results. Some of them were not prefetched,
+     * their icons are left to the prefetch and shown by the next query.
+     */
+    void testKeystrokes()
+    {
+        const QString query = QStringLiteral("b item 42 gen");
+        int withoutIcon = 0;
+        for (int length = 3; length <= query.size(); ++length) {
+            const Measurement measurement = measure(query.left(length));
+            verifyBudget(query.left(length), measurement);
+            if (QTest::currentTestFailed()) {
+                return;
+            }
+            withoutIcon += measurement.matches - measurement.icons;
+        }
+        QVERIFY(withoutIcon > 0);
+        const Measurement again = measure(query);
+        verifyBudget(query, again);
+        QCOMPARE(again.icons, again.matches);
+    }
+};
+
+QTEST_MAIN(QueryBudgetTest)
+
+#include "QueryBudgetTest.moc"
@@ -0,0 +1,76 @@
+#include "dbus/StatsService.h"
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusInterface>
+#include <QDBusReply>
+#include <QSignalSpy>
+#include <QTest>
+
+/**
+ * Talks to the service over the session bus, run it with "dbus-run-session -- stats_service_test"
+ * when there is no session
+ */
+class StatsServiceTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QString serviceName()
+    {
+        return QStringLiteral("org.kde.zenbookmark.test%1").arg(QCoreApplication::applicationPid());
+    }
+
+private Q_SLOTS:
+    static void initTestCase()
+    {
+        if (!QDBusConnection::sessionBus().isConnected()) {
+            QSKIP("No session bus");
+        }
+    }
+
+    static void testStats()
+    {
+        StatsService service;
+        service.setStatsProvider([]() {
+            return QVariantMap{{QStringLiteral("indexGeneration"), 3}, {QStringLiteral("indexEntries"), 42}};
+        });
+        for (int i = 1; i <= StatsService::RecentQueryCount + 2; ++i) {
+            service.recordQuery(i);
+        }
+        QVERIFY(service.registerOn(QDBusConnection::sessionBus(), serviceName()));
+
+        QDBusInterface interface(serviceName(), StatsService::ObjectPath, QStringLiteral("org.kde.zenbookmark.Stats"));
+        QVERIFY(interface.isValid());
+        const QDBusReply<QVariantMap> reply = interface.call(QStringLiteral("Stats"));
+        QVERIFY2(reply.isValid(), qPrintable(reply.error().message()));
+        const QVariantMap stats = reply.value();
+        QCOMPARE(stats.value("indexGeneration").toInt(), 3);
+        QCOMPARE(stats.value("indexEntries").toInt(), 42);
+        QCOMPARE(stats.value("queryCount").toULongLong(), quint64(StatsService::RecentQueryCount + 2));
+
+        // Only the recent latencies are kept, oldest first
+        const QVariantList recent = qdbus_cast<QVariantList>(stats.value("recentQueryLatenciesUs"));
+        QCOMPARE(recent.size(), StatsService::RecentQueryCount);
+        QCOMPARE(recent.first().toLongLong(), 3);
+        QCOMPARE(recent.last().toLongLong(), StatsService::RecentQueryCount + 2);
+        QCOMPARE(stats.value("queryLatencyP50Us").toLongLong(), StatsService::RecentQueryCount / 2 + 3);
+    }
+
+    static void testControl()
+    {
+        StatsService service;
+        QSignalSpy reindexSpy(&service, &StatsService::reindexRequested);
+        QSignalSpy dropSpy(&service, &StatsService::dropCachesRequested);
+        QVERIFY(service.registerOn(QDBusConnection::sessionBus(), serviceName()));
+
+        QDBusInterface interface(serviceName(), StatsService::ObjectPath, QStringLiteral("org.kde.zenbookmark.Stats"));
+        QVERIFY(interface.call(QStringLiteral("Reindex")).type() != QDBusMessage::ErrorMessage);
+        QVERIFY(interface.call(QStringLiteral("DropCaches")).type() != QDBusMessage::ErrorMessage);
+        QCOMPARE(reindexSpy.count(), 1);
+        QCOMPARE(dropSpy.count(), 1);
+    }
+};
+
+QTEST_GUILESS_MAIN(StatsServiceTest)
+
+#include "StatsServiceTest.moc"
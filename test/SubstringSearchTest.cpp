@@ -0,0 +1,129 @@
+#include "bookmarks/SubstringSearch.h"
+#include <QRandomGenerator>
+#include <QTest>
+
+class SubstringSearchTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QVector<SubstringSearch::Implementation> implementations()
+    {
+        QVector<SubstringSearch::Implementation> supported;
+        for (const auto implementation : {SubstringSearch::Implementation::Scalar, SubstringSearch::Implementation::Sse2, SubstringSearch::Implementation::Avx2}) {
+            if (SubstringSearch::isSupported(implementation)) {
+                supported.append(implementation);
+            }
+        }
+        return supported;
+    }
+
+    static bool contains(SubstringSearch::Implementation implementation, const QString &text, const QString &needle)
+    {
+        return SubstringSearch::contains(implementation,
+                                         reinterpret_cast<const char16_t *>(text.utf16()),
+                                         text.size(),
+                                         reinterpret_cast<const char16_t *>(needle.utf16()),
+                                         needle.size());
+    }
+
+    static QString randomText(QRandomGenerator &random, int length, int alphabetSize)
+    {
+        QString text(length, Qt::Uninitialized);
+        for (QChar &c : text) {
+            c = QChar(char16_t(u'a' + random.bounded(alphabetSize)));
+        }
+        return text;
+    }
+
+    /**
+     * Case folded titles like the index stores them, the needle occurs in a few of them
+     */
+    static QStringList createTitles(int count)
+    {
+        QRandomGenerator random(42);
+        QStringList titles;
+        titles.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            QString title = randomText(random, 20 + random.bounded(60), 26);
+            if (i % 1000 == 0) {
+                title.insert(random.bounded(title.size()), QStringLiteral("grafana"));
+            }
+            titles.append(title.toCaseFolded());
+        }
+        return titles;
+    }
+
+private Q_SLOTS:
+    /**
+     * Every implementation agrees with QString::indexOf, the small alphabet produces many partial matches
+     */
+    static void testMatchesQString()
+    {
+        QRandomGenerator random(1);
+        for (int i = 0; i < 20000; ++i) {
+            const QString text = randomText(random, random.bounded(80), 3);
+            const QString needle = randomText(random, random.bounded(7), 3);
+            const bool expected = text.indexOf(needle) != -1;
+            for (const auto implementation : implementations()) {
+                QCOMPARE(contains(implementation, text, needle), expected);
+            }
+        }
+    }
+
+    static void testNonAscii()
+    {
+        const QString text = QStringLiteral("Überblick über die Straße – 日本語のページ").toCaseFolded();
+        for (const auto implementation : implementations()) {
+            QVERIFY(contains(implementation, text, QStringLiteral("ÜBER").toCaseFolded()));
+            QVERIFY(contains(implementation, text, QStringLiteral("日本語")));
+            QVERIFY(!contains(implementation, text, QStringLiteral("日本人")));
+        }
+    }
+
+    static void benchmarkScan_data()
+    {
+        QTest::addColumn<int>("implementation");
+        QTest::addColumn<int>("entries");
+        for (const int entries : {10000, 100000}) {
+            // -1 is the QString::contains(..., Qt::CaseInsensitive) scan this replaces
+            QTest::addRow("QString %d", entries) << -1 << entries;
+            for (const auto implementation : implementations()) {
+                QTest::addRow("%s %d", SubstringSearch::implementationName(implementation), entries) << int(implementation) << entries;
+            }
+        }
+    }
+
+    /**
+     * Scan of all titles for a query that matches in 0.1% of them
+     */
+    static void benchmarkScan()
+    {
+        QFETCH(int, implementation);
+        QFETCH(int, entries);
+        const QStringList titles = createTitles(entries);
+        const QString needle = QStringLiteral("grafana");
+        int found = 0;
+        if (implementation == -1) {
+            QBENCHMARK {
+                found = 0;
+                for (const QString &title : titles) {
+                    found += title.contains(needle, Qt::CaseInsensitive) ? 1 : 0;
+                }
+            }
+        } else {
+            const auto selected = SubstringSearch::Implementation(implementation);
+            QBENCHMARK {
+                found = 0;
+                for (const QString &title : titles) {
+                    found += contains(selected, title, needle) ? 1 : 0;
+                }
+            }
+        }
+        QCOMPARE(found, entries / 1000);
+    }
+};
+
+QTEST_MAIN(SubstringSearchTest)
+
+#include "SubstringSearchTest.moc"
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "bookmarks/BookmarkIndex.h"
+
+/**
+ * Indexes shared by the tests
+ */
+namespace TestIndex
+{
+inline Bookmark bookmark(const QString &title, const QString &url, const QString &folder = QString(), const QStringList &tags = QStringList())
+{
+    Bookmark bookmark;
+    bookmark.title = title;
+    bookmark.url = url;
+    bookmark.folder = folder;
+    bookmark.tags = tags;
+    return bookmark;
+}
+
+/**
+ * Index of the bookmarks, their ids are assigned from 1 in the given order
+ */
+inline BookmarkIndex create(QList<Bookmark> bookmarks)
+{
+    BookmarkIndex index;
+    qint64 id = 1;
+    for (Bookmark &bookmark : bookmarks) {
+        bookmark.id = id++;
+        index.upsert(bookmark);
+    }
+    return index;
+}
+
+/**
+ * "Bookmark 1" to "Bookmark <count>" with the URLs https://example.com/1 and so on
+ */
+inline BookmarkIndex numbered(int count)
+{
+    QList<Bookmark> bookmarks;
+    bookmarks.reserve(count);
+    for (int i = 1; i <= count; ++i) {
+        bookmarks.append(bookmark(QStringLiteral("Bookmark %1").arg(i), QStringLiteral("https://example.com/%1").arg(i)));
+    }
+    return create(bookmarks);
+}
+}